@@ -0,0 +1,415 @@
+#include "aabbtree.h"
+
+#include "math.h"
+#include "string.h"
+
+#define AABB_TREE_STACK 256
+
+static inline Aabb Union(Aabb a, Aabb b)
+{
+    return (Aabb) { fminf(a.minX, b.minX), fminf(a.minY, b.minY), fmaxf(a.maxX, b.maxX), fmaxf(a.maxY, b.maxY) };
+}
+
+static inline int MaxInt(int a, int b)
+{
+    return a > b ? a : b;
+}
+
+static inline float Perimeter(Aabb a)
+{
+    return 2 * ((a.maxX - a.minX) + (a.maxY - a.minY));
+}
+
+static inline bool Contains(Aabb outer, Aabb inner)
+{
+    return outer.minX <= inner.minX && outer.minY <= inner.minY && inner.maxX <= outer.maxX && inner.maxY <= outer.maxY;
+}
+
+static inline bool Overlaps(Aabb a, Aabb b)
+{
+    return a.minX < b.maxX && b.minX < a.maxX && a.minY < b.maxY && b.minY < a.maxY;
+}
+
+static inline Aabb BodyBox(float x, float y, float sizeX, float sizeY)
+{
+    return (Aabb) { x - sizeX, y - sizeY, x + sizeX, y + sizeY };
+}
+
+void AabbTreeInit(AabbTree* tree, float margin)
+{
+    memset(tree, 0, sizeof(*tree));
+    tree->margin = margin;
+    tree->freeNode = -1;
+    tree->root = -1;
+}
+
+void AabbTreeFree(AabbTree* tree)
+{
+    free(tree->nodes);
+    free(tree->keyLeaf);
+    free(tree->tasks);
+    memset(tree, 0, sizeof(*tree));
+}
+
+static int AllocateNode(AabbTree* tree)
+{
+    if (tree->freeNode < 0) {
+        int capacity = tree->nodeCapacity ? tree->nodeCapacity * 2 : 256;
+        tree->nodes = realloc(tree->nodes, sizeof(AabbNode) * capacity);
+        for (int n = tree->nodeCapacity; n < capacity; n++) {
+            tree->nodes[n].parent = n + 1 < capacity ? n + 1 : -1;
+            tree->nodes[n].height = -1;
+        }
+        tree->freeNode = tree->nodeCapacity;
+        tree->nodeCapacity = capacity;
+    }
+    int node = tree->freeNode;
+    tree->freeNode = tree->nodes[node].parent;
+    if (node >= tree->nodeCount) tree->nodeCount = node + 1;
+    AabbNode* n = tree->nodes + node;
+    n->parent = n->left = n->right = -1;
+    n->height = 0;
+    n->body = -1;
+    return node;
+}
+
+static void FreeNode(AabbTree* tree, int node)
+{
+    tree->nodes[node].parent = tree->freeNode;
+    tree->nodes[node].height = -1;
+    tree->freeNode = node;
+}
+
+static void ReplaceChild(AabbTree* tree, int parent, int oldChild, int newChild)
+{
+    if (parent < 0) {
+        tree->root = newChild;
+    } else if (tree->nodes[parent].left == oldChild) {
+        tree->nodes[parent].left = newChild;
+    } else {
+        tree->nodes[parent].right = newChild;
+    }
+}
+
+// Rotates the taller grandchild up when the children of a differ in height by more than one;
+// returns the node now in a's place.
+static int Balance(AabbTree* tree, int a)
+{
+    AabbNode* nodes = tree->nodes;
+    AabbNode* A = nodes + a;
+    if (A->left < 0 || A->height < 2) return a;
+    int b = A->left, c = A->right;
+    AabbNode* B = nodes + b;
+    AabbNode* C = nodes + c;
+    int balance = C->height - B->height;
+
+    if (balance > 1) {
+        int f = C->left, g = C->right;
+        AabbNode* F = nodes + f;
+        AabbNode* G = nodes + g;
+        C->left = a;
+        C->parent = A->parent;
+        A->parent = c;
+        ReplaceChild(tree, C->parent, a, c);
+        if (F->height > G->height) {
+            C->right = f;
+            A->right = g;
+            G->parent = a;
+            A->box = Union(B->box, G->box);
+            C->box = Union(A->box, F->box);
+            A->height = 1 + MaxInt(B->height, G->height);
+            C->height = 1 + MaxInt(A->height, F->height);
+        } else {
+            C->right = g;
+            A->right = f;
+            F->parent = a;
+            A->box = Union(B->box, F->box);
+            C->box = Union(A->box, G->box);
+            A->height = 1 + MaxInt(B->height, F->height);
+            C->height = 1 + MaxInt(A->height, G->height);
+        }
+        return c;
+    }
+
+    if (balance < -1) {
+        int d = B->left, e = B->right;
+        AabbNode* D = nodes + d;
+        AabbNode* E = nodes + e;
+        B->left = a;
+        B->parent = A->parent;
+        A->parent = b;
+        ReplaceChild(tree, B->parent, a, b);
+        if (D->height > E->height) {
+            B->right = d;
+            A->left = e;
+            E->parent = a;
+            A->box = Union(C->box, E->box);
+            B->box = Union(A->box, D->box);
+            A->height = 1 + MaxInt(C->height, E->height);
+            B->height = 1 + MaxInt(A->height, D->height);
+        } else {
+            B->right = e;
+            A->left = d;
+            D->parent = a;
+            A->box = Union(C->box, D->box);
+            B->box = Union(A->box, E->box);
+            A->height = 1 + MaxInt(C->height, D->height);
+            B->height = 1 + MaxInt(A->height, E->height);
+        }
+        return b;
+    }
+    return a;
+}
+
+// Rebalances and refits from node up to the root.
+static void Refit(AabbTree* tree, int node)
+{
+    while (node >= 0) {
+        node = Balance(tree, node);
+        AabbNode* n = tree->nodes + node;
+        AabbNode* left = tree->nodes + n->left;
+        AabbNode* right = tree->nodes + n->right;
+        n->height = 1 + MaxInt(left->height, right->height);
+        n->box = Union(left->box, right->box);
+        node = n->parent;
+    }
+}
+
+static void InsertLeaf(AabbTree* tree, int leaf)
+{
+    if (tree->root < 0) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = -1;
+        return;
+    }
+
+    // descend towards the cheapest sibling: the cost of a new parent here against the
+    // perimeter growth pushed onto either child
+    Aabb box = tree->nodes[leaf].box;
+    int node = tree->root;
+    while (tree->nodes[node].left >= 0) {
+        AabbNode* n = tree->nodes + node;
+        float area = Perimeter(n->box);
+        float combinedArea = Perimeter(Union(n->box, box));
+        float cost = 2 * combinedArea;
+        float inheritance = 2 * (combinedArea - area);
+
+        AabbNode* left = tree->nodes + n->left;
+        AabbNode* right = tree->nodes + n->right;
+        float costLeft = Perimeter(Union(box, left->box)) + inheritance;
+        float costRight = Perimeter(Union(box, right->box)) + inheritance;
+        if (left->left >= 0) costLeft -= Perimeter(left->box);
+        if (right->left >= 0) costRight -= Perimeter(right->box);
+
+        if (cost < costLeft && cost < costRight) break;
+        node = costLeft < costRight ? n->left : n->right;
+    }
+
+    int sibling = node;
+    int oldParent = tree->nodes[sibling].parent;
+    int parent = AllocateNode(tree);
+    AabbNode* p = tree->nodes + parent;
+    p->parent = oldParent;
+    p->box = Union(box, tree->nodes[sibling].box);
+    p->height = tree->nodes[sibling].height + 1;
+    p->left = sibling;
+    p->right = leaf;
+    ReplaceChild(tree, oldParent, sibling, parent);
+    tree->nodes[sibling].parent = parent;
+    tree->nodes[leaf].parent = parent;
+    Refit(tree, parent);
+}
+
+static void RemoveLeaf(AabbTree* tree, int leaf)
+{
+    if (leaf == tree->root) {
+        tree->root = -1;
+        return;
+    }
+    int parent = tree->nodes[leaf].parent;
+    int grandParent = tree->nodes[parent].parent;
+    int sibling = tree->nodes[parent].left == leaf ? tree->nodes[parent].right : tree->nodes[parent].left;
+    ReplaceChild(tree, grandParent, parent, sibling);
+    tree->nodes[sibling].parent = grandParent;
+    FreeNode(tree, parent);
+    Refit(tree, grandParent);
+}
+
+static Aabb Fatten(const AabbTree* tree, Aabb box)
+{
+    return (Aabb) { box.minX - tree->margin, box.minY - tree->margin, box.maxX + tree->margin, box.maxY + tree->margin };
+}
+
+void AabbTreeInsert(AabbTree* tree, int key, Aabb box)
+{
+    if (key >= tree->keyCapacity) {
+        int capacity = tree->keyCapacity ? tree->keyCapacity : 256;
+        while (capacity <= key) capacity *= 2;
+        tree->keyLeaf = realloc(tree->keyLeaf, sizeof(int) * capacity);
+        for (int k = tree->keyCapacity; k < capacity; k++) {
+            tree->keyLeaf[k] = -1;
+        }
+        tree->keyCapacity = capacity;
+    }
+    int leaf = AllocateNode(tree);
+    AabbNode* n = tree->nodes + leaf;
+    n->tight = box;
+    n->box = Fatten(tree, box);
+    n->body = key;
+    n->epoch = tree->epoch;
+    InsertLeaf(tree, leaf);
+    tree->keyLeaf[key] = leaf;
+    tree->leafCount += 1;
+}
+
+void AabbTreeRemove(AabbTree* tree, int key)
+{
+    if (key < 0 || key >= tree->keyCapacity || tree->keyLeaf[key] < 0) return;
+    int leaf = tree->keyLeaf[key];
+    RemoveLeaf(tree, leaf);
+    FreeNode(tree, leaf);
+    tree->keyLeaf[key] = -1;
+    tree->leafCount -= 1;
+}
+
+bool AabbTreeMove(AabbTree* tree, int key, Aabb box)
+{
+    int leaf = tree->keyLeaf[key];
+    AabbNode* n = tree->nodes + leaf;
+    n->tight = box;
+    n->epoch = tree->epoch;
+    if (Contains(n->box, box)) return false;
+    RemoveLeaf(tree, leaf);
+    n = tree->nodes + leaf;
+    n->box = Fatten(tree, box);
+    InsertLeaf(tree, leaf);
+    return true;
+}
+
+void AabbTreeUpdate(AabbTree* tree, const float* x, const float* y, const float* sizeX, const float* sizeY, const int* keys, int count)
+{
+    tree->epoch += 1;
+    tree->reinserted = 0;
+    for (int i = 0; i < count; i++) {
+        Aabb box = BodyBox(x[i], y[i], sizeX[i], sizeY[i]);
+        int key = keys[i];
+        if (key < tree->keyCapacity && tree->keyLeaf[key] >= 0) {
+            tree->reinserted += AabbTreeMove(tree, key, box);
+        } else {
+            AabbTreeInsert(tree, key, box);
+        }
+    }
+    if (tree->leafCount == count) return;
+    for (int node = 0; node < tree->nodeCount; node++) {
+        AabbNode* n = tree->nodes + node;
+        if (n->height == 0 && n->epoch != tree->epoch) {
+            AabbTreeRemove(tree, n->body);
+        }
+    }
+}
+
+int AabbTreeQuery(const AabbTree* tree, Aabb box, int* keys, int capacity)
+{
+    if (tree->root < 0) return 0;
+    int stack[AABB_TREE_STACK];
+    int top = 0;
+    int found = 0;
+    stack[top++] = tree->root;
+    while (top > 0) {
+        const AabbNode* n = tree->nodes + stack[--top];
+        if (!Overlaps(n->box, box)) continue;
+        if (n->left < 0) {
+            if (Overlaps(n->tight, box)) {
+                if (found < capacity) keys[found] = n->body;
+                found += 1;
+            }
+        } else {
+            stack[top++] = n->left;
+            stack[top++] = n->right;
+        }
+    }
+    return found;
+}
+
+static inline void PushTask(AabbTree* tree, int a, int b)
+{
+    if (tree->taskCount == tree->taskCapacity) {
+        tree->taskCapacity = tree->taskCapacity ? tree->taskCapacity * 2 : 256;
+        tree->tasks = realloc(tree->tasks, sizeof(BodyPair) * tree->taskCapacity);
+    }
+    tree->tasks[tree->taskCount++] = (BodyPair) { a, b };
+}
+
+void AabbTreePrepareTasks(AabbTree* tree, int target)
+{
+    // a task (a, a) stands for all pairs inside subtree a, (a, b) for pairs across a and b;
+    // split the biggest ones until there are enough to go around
+    tree->taskCount = 0;
+    if (tree->root < 0) return;
+    PushTask(tree, tree->root, tree->root);
+    for (int pass = 0; pass < 32 && tree->taskCount < target; pass++) {
+        int count = tree->taskCount;
+        bool split = false;
+        for (int t = 0; t < count; t++) {
+            BodyPair task = tree->tasks[t];
+            AabbNode* a = tree->nodes + task.a;
+            AabbNode* b = tree->nodes + task.b;
+            if (task.a == task.b) {
+                if (a->left < 0) continue;
+                tree->tasks[t] = (BodyPair) { a->left, a->left };
+                PushTask(tree, a->right, a->right);
+                PushTask(tree, a->left, a->right);
+                split = true;
+            } else if (a->left >= 0 || b->left >= 0) {
+                if (b->left >= 0 && (a->left < 0 || b->height > a->height)) {
+                    AabbNode* swap = a;
+                    a = b;
+                    b = swap;
+                    task = (BodyPair) { task.b, task.a };
+                }
+                tree->tasks[t] = (BodyPair) { a->left, task.b };
+                PushTask(tree, a->right, task.b);
+                split = true;
+            }
+        }
+        if (!split) break;
+    }
+}
+
+void AabbTreeFindPairs(const AabbTree* tree, const float* x, const float* y, const float* sizeX, const float* sizeY, const int* keyIndex, int begin, int end, PairList* pairs)
+{
+    BodyPair stack[AABB_TREE_STACK];
+    for (int t = begin; t < end; t++) {
+        int top = 0;
+        stack[top++] = tree->tasks[t];
+        while (top > 0) {
+            BodyPair task = stack[--top];
+            const AabbNode* a = tree->nodes + task.a;
+            const AabbNode* b = tree->nodes + task.b;
+            if (task.a == task.b) {
+                if (a->left < 0) continue;
+                stack[top++] = (BodyPair) { a->left, a->left };
+                stack[top++] = (BodyPair) { a->right, a->right };
+                stack[top++] = (BodyPair) { a->left, a->right };
+                continue;
+            }
+            if (!Overlaps(a->box, b->box)) continue;
+            if (a->left < 0 && b->left < 0) {
+                // same test as the grid, on the arrays rather than the stored boxes
+                int i = keyIndex[a->body], j = keyIndex[b->body];
+                if (fabsf(x[i] - x[j]) < sizeX[i] + sizeX[j] && fabsf(y[i] - y[j]) < sizeY[i] + sizeY[j]) {
+                    PairListPush(pairs, i, j);
+                }
+                continue;
+            }
+            // descend the taller side
+            if (b->left >= 0 && (a->left < 0 || b->height > a->height)) {
+                stack[top++] = (BodyPair) { task.a, b->left };
+                stack[top++] = (BodyPair) { task.a, b->right };
+            } else {
+                stack[top++] = (BodyPair) { a->left, task.b };
+                stack[top++] = (BodyPair) { a->right, task.b };
+            }
+        }
+    }
+}
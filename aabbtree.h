@@ -0,0 +1,70 @@
+#ifndef AABBTREE_H
+#define AABBTREE_H
+
+#include "stdbool.h"
+
+#include "broadphase.h"
+
+typedef struct {
+    float minX, minY;
+    float maxX, maxY;
+} Aabb;
+
+typedef struct {
+    Aabb box; // fattened for leaves, the union of the children otherwise
+    Aabb tight; // leaves only: the body's actual box
+    int parent; // next free node while the node is free
+    int left; // -1 for leaves
+    int right;
+    int height; // 0 for leaves
+    int body; // leaves only: the key the body was inserted with
+    int epoch; // leaves only: last update that saw the body
+} AabbNode;
+
+// Dynamic bounding volume tree (as in Box2D's b2DynamicTree): leaves hold boxes fattened by
+// margin, inner nodes their union, and inserts pick the sibling by perimeter cost and rebalance
+// with AVL rotations. A body that stays inside its fat box costs nothing to update, so large
+// and small bodies mix freely, unlike on a uniform grid.
+//
+// Bodies are keyed by a stable id (the world's handle slot) so the tree survives the dense
+// arrays being compacted or reordered.
+typedef struct {
+    float margin;
+
+    AabbNode* nodes;
+    int nodeCount;
+    int nodeCapacity;
+    int freeNode;
+    int root;
+    int* keyLeaf; // body key -> leaf, -1 when absent
+    int keyCapacity;
+    int epoch;
+
+    BodyPair* tasks; // node pairs that AabbTreeFindPairs splits across threads
+    int taskCount;
+    int taskCapacity;
+
+    int leafCount;
+    int reinserted; // leaves moved out of their fat box in the last update
+} AabbTree;
+
+void AabbTreeInit(AabbTree* tree, float margin);
+void AabbTreeFree(AabbTree* tree);
+void AabbTreeInsert(AabbTree* tree, int key, Aabb box);
+void AabbTreeRemove(AabbTree* tree, int key);
+// Refits the body's tight box; the leaf is only reinserted when it leaves its fat box.
+// Returns true when it was.
+bool AabbTreeMove(AabbTree* tree, int key, Aabb box);
+// Syncs the tree with count bodies of half extents sizeX/sizeY keyed by keys[i]: inserts new
+// ones, moves the rest and removes every leaf whose key is not listed.
+void AabbTreeUpdate(AabbTree* tree, const float* x, const float* y, const float* sizeX, const float* sizeY, const int* keys, int count);
+// Writes up to capacity keys of bodies whose tight boxes overlap box; returns how many overlap.
+int AabbTreeQuery(const AabbTree* tree, Aabb box, int* keys, int capacity);
+// Splits the self-overlap traversal of the whole tree into at least target independent node
+// pairs where the tree allows, for AabbTreeFindPairs to run in parallel.
+void AabbTreePrepareTasks(AabbTree* tree, int target);
+// Runs tasks [begin, end) of a simultaneous descent of the tree against itself, reporting every
+// overlapping pair once as indices (keyIndex maps a key back to its index into the arrays).
+void AabbTreeFindPairs(const AabbTree* tree, const float* x, const float* y, const float* sizeX, const float* sizeY, const int* keyIndex, int begin, int end, PairList* pairs);
+
+#endif
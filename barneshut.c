@@ -0,0 +1,198 @@
+#include "barneshut.h"
+
+#include "math.h"
+#include "stdbool.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define BARNES_HUT_MAX_DEPTH 24
+#define BARNES_HUT_STACK_SIZE (3 * BARNES_HUT_MAX_DEPTH + 8)
+
+void BarnesHutInit(BarnesHut* bh, float theta)
+{
+    memset(bh, 0, sizeof(*bh));
+    bh->theta = theta;
+    bh->leafSize = 4;
+}
+
+void BarnesHutFree(BarnesHut* bh)
+{
+    free(bh->nodes);
+    free(bh->bodies);
+    free(bh->scratch);
+    memset(bh, 0, sizeof(*bh));
+}
+
+static int AllocNodes(BarnesHut* bh, int count)
+{
+    if (bh->nodeCount + count > bh->nodeCapacity) {
+        int capacity = bh->nodeCapacity ? bh->nodeCapacity * 2 : 256;
+        while (capacity < bh->nodeCount + count) capacity *= 2;
+        bh->nodes = realloc(bh->nodes, sizeof(QuadNode) * capacity);
+        bh->nodeCapacity = capacity;
+    }
+    int first = bh->nodeCount;
+    bh->nodeCount += count;
+    return first;
+}
+
+static void BuildNode(BarnesHut* bh, int nodeIndex, const float* x, const float* y, const float* mass, int depth)
+{
+    QuadNode node = bh->nodes[nodeIndex];
+    int start = node.bodyStart;
+    int end = node.bodyStart + node.bodyCount;
+
+    if (node.bodyCount <= bh->leafSize || depth >= BARNES_HUT_MAX_DEPTH) {
+        float m = 0, mx = 0, my = 0;
+        for (int k = start; k < end; k++) {
+            int b = bh->bodies[k];
+            m += mass[b];
+            mx += mass[b] * x[b];
+            my += mass[b] * y[b];
+        }
+        node.mass = m;
+        node.comX = m > 0 ? mx / m : node.minX + node.width / 2;
+        node.comY = m > 0 ? my / m : node.minY + node.width / 2;
+        bh->nodes[nodeIndex] = node;
+        return;
+    }
+
+    float half = node.width / 2;
+    float midX = node.minX + half;
+    float midY = node.minY + half;
+
+    // counting sort of the node's bodies into its four quadrants
+    int counts[4] = {0};
+    for (int k = start; k < end; k++) {
+        int b = bh->bodies[k];
+        counts[(x[b] >= midX) + 2 * (y[b] >= midY)] += 1;
+    }
+    int offsets[4] = { start, start + counts[0], start + counts[0] + counts[1], start + counts[0] + counts[1] + counts[2] };
+    int cursor[4] = { offsets[0], offsets[1], offsets[2], offsets[3] };
+    for (int k = start; k < end; k++) {
+        int b = bh->bodies[k];
+        bh->scratch[cursor[(x[b] >= midX) + 2 * (y[b] >= midY)]++] = b;
+    }
+    memcpy(bh->bodies + start, bh->scratch + start, sizeof(int) * node.bodyCount);
+
+    int firstChild = AllocNodes(bh, 4);
+    for (int q = 0; q < 4; q++) {
+        QuadNode child = {0};
+        child.minX = node.minX + (q & 1 ? half : 0);
+        child.minY = node.minY + (q & 2 ? half : 0);
+        child.width = half;
+        child.firstChild = -1;
+        child.bodyStart = offsets[q];
+        child.bodyCount = counts[q];
+        bh->nodes[firstChild + q] = child;
+        BuildNode(bh, firstChild + q, x, y, mass, depth + 1);
+    }
+
+    float m = 0, mx = 0, my = 0;
+    for (int q = 0; q < 4; q++) {
+        QuadNode* child = bh->nodes + firstChild + q;
+        m += child->mass;
+        mx += child->mass * child->comX;
+        my += child->mass * child->comY;
+    }
+    node.firstChild = firstChild;
+    node.mass = m;
+    node.comX = m > 0 ? mx / m : midX;
+    node.comY = m > 0 ? my / m : midY;
+    bh->nodes[nodeIndex] = node;
+}
+
+void BarnesHutBuild(BarnesHut* bh, const float* x, const float* y, const float* mass, int count)
+{
+    if (count > bh->bodyCapacity) {
+        bh->bodies = realloc(bh->bodies, sizeof(int) * count);
+        bh->scratch = realloc(bh->scratch, sizeof(int) * count);
+        bh->bodyCapacity = count;
+    }
+    bh->nodeCount = 0;
+
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    for (int i = 0; i < count; i++) {
+        bh->bodies[i] = i;
+        minX = fminf(minX, x[i]);
+        minY = fminf(minY, y[i]);
+        maxX = fmaxf(maxX, x[i]);
+        maxY = fmaxf(maxY, y[i]);
+    }
+    if (count == 0) {
+        minX = minY = maxX = maxY = 0;
+    }
+
+    QuadNode root = {0};
+    root.minX = minX;
+    root.minY = minY;
+    // pad the square so bodies on the max edge still fall inside the upper quadrants
+    root.width = fmaxf(fmaxf(maxX - minX, maxY - minY), 1.0f) * 1.0001f;
+    root.firstChild = -1;
+    root.bodyStart = 0;
+    root.bodyCount = count;
+
+    int rootIndex = AllocNodes(bh, 1);
+    bh->nodes[rootIndex] = root;
+    BuildNode(bh, rootIndex, x, y, mass, 0);
+}
+
+void BarnesHutForce(const BarnesHut* bh, const float* x, const float* y, const float* mass, int i, float* fx, float* fy)
+{
+    const float G = GRAVITY_CONSTANT;
+    const float theta2 = bh->theta * bh->theta;
+    float px = x[i];
+    float py = y[i];
+    float ax = 0, ay = 0;
+
+    int stack[BARNES_HUT_STACK_SIZE];
+    int top = 0;
+    if (bh->nodeCount > 0) stack[top++] = 0;
+
+    while (top > 0) {
+        const QuadNode* node = bh->nodes + stack[--top];
+        if (node->mass <= 0) continue;
+
+        if (node->firstChild < 0) {
+            for (int k = node->bodyStart; k < node->bodyStart + node->bodyCount; k++) {
+                int j = bh->bodies[k];
+                if (j == i) continue;
+                float dx = x[j] - px;
+                float dy = y[j] - py;
+                float r2 = dx * dx + dy * dy;
+                float r = sqrtf(r2);
+                float s = mass[j] / (r2 * r);
+                ax += dx * s;
+                ay += dy * s;
+            }
+            continue;
+        }
+
+        float dx = node->comX - px;
+        float dy = node->comY - py;
+        float r2 = dx * dx + dy * dy;
+        // never approximate a cell that contains the body itself
+        bool inside = px >= node->minX && px < node->minX + node->width && py >= node->minY && py < node->minY + node->width;
+        if (!inside && node->width * node->width < theta2 * r2) {
+            float r = sqrtf(r2);
+            float s = node->mass / (r2 * r);
+            ax += dx * s;
+            ay += dy * s;
+        } else {
+            for (int q = 0; q < 4; q++) {
+                stack[top++] = node->firstChild + q;
+            }
+        }
+    }
+
+    *fx = G * mass[i] * ax;
+    *fy = G * mass[i] * ay;
+}
+
+void BarnesHutForces(BarnesHut* bh, const float* x, const float* y, const float* mass, int count, float* fx, float* fy)
+{
+    BarnesHutBuild(bh, x, y, mass, count);
+    for (int i = 0; i < count; i++) {
+        BarnesHutForce(bh, x, y, mass, i, fx + i, fy + i);
+    }
+}
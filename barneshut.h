@@ -0,0 +1,37 @@
+#ifndef BARNESHUT_H
+#define BARNESHUT_H
+
+#include "gravity.h"
+
+// Barnes-Hut quadtree over point masses. A node is approximated by its center of mass
+// when width / distance < theta; theta = 0 degenerates to the direct sum.
+typedef struct {
+    float minX, minY;
+    float width;
+    float mass;
+    float comX, comY;
+    int firstChild; // index of 4 consecutive children, -1 for leaves
+    int bodyStart;
+    int bodyCount;
+} QuadNode;
+
+typedef struct {
+    float theta;
+    int leafSize;
+    QuadNode* nodes;
+    int nodeCount;
+    int nodeCapacity;
+    int* bodies; // body indices, grouped so every node owns a contiguous range
+    int* scratch;
+    int bodyCapacity;
+} BarnesHut;
+
+void BarnesHutInit(BarnesHut* bh, float theta);
+void BarnesHutFree(BarnesHut* bh);
+void BarnesHutBuild(BarnesHut* bh, const float* x, const float* y, const float* mass, int count);
+// Force on body i, same semantics as gravity(): G * mi * mj / r^2 towards every other body.
+void BarnesHutForce(const BarnesHut* bh, const float* x, const float* y, const float* mass, int i, float* fx, float* fy);
+// Builds the tree and writes the force for every body.
+void BarnesHutForces(BarnesHut* bh, const float* x, const float* y, const float* mass, int count, float* fx, float* fy);
+
+#endif
@@ -0,0 +1,105 @@
+#include "batch.h"
+
+#include "stdlib.h"
+#include "string.h"
+
+#include "simd.h"
+
+#define BATCH_ALIGNMENT 64
+
+static void* AllocLanes(int count, size_t elementSize)
+{
+    size_t bytes = (size_t)count * WORLD_BATCH_LANES * elementSize;
+    bytes = (bytes + BATCH_ALIGNMENT - 1) / BATCH_ALIGNMENT * BATCH_ALIGNMENT;
+    void* array = aligned_alloc(BATCH_ALIGNMENT, bytes ? bytes : BATCH_ALIGNMENT);
+    memset(array, 0, bytes);
+    return array;
+}
+
+void WorldBatchInit(WorldBatch* batch, int count, float width, float height)
+{
+    memset(batch, 0, sizeof(WorldBatch));
+    batch->count = count;
+    batch->width = width;
+    batch->height = height;
+    batch->posX = AllocLanes(count, sizeof(float));
+    batch->posY = AllocLanes(count, sizeof(float));
+    batch->speedX = AllocLanes(count, sizeof(float));
+    batch->speedY = AllocLanes(count, sizeof(float));
+    batch->mass = AllocLanes(count, sizeof(float));
+    batch->sizeX = AllocLanes(count, sizeof(float));
+    batch->sizeY = AllocLanes(count, sizeof(float));
+    batch->stiffness = AllocLanes(count, sizeof(float));
+    batch->energyLoss = AllocLanes(count, sizeof(float));
+    batch->forceX = AllocLanes(count, sizeof(float));
+    batch->forceY = AllocLanes(count, sizeof(float));
+    batch->bounceX = AllocLanes(count, sizeof(int));
+    batch->bounceY = AllocLanes(count, sizeof(int));
+    batch->touchX = AllocLanes(count, sizeof(int));
+    batch->touchY = AllocLanes(count, sizeof(int));
+    batch->drawSizeX = AllocLanes(count, sizeof(float));
+    batch->drawSizeY = AllocLanes(count, sizeof(float));
+    batch->accX = AllocLanes(count, sizeof(float));
+    batch->accY = AllocLanes(count, sizeof(float));
+}
+
+void WorldBatchFree(WorldBatch* batch)
+{
+    free(batch->posX);
+    free(batch->posY);
+    free(batch->speedX);
+    free(batch->speedY);
+    free(batch->mass);
+    free(batch->sizeX);
+    free(batch->sizeY);
+    free(batch->stiffness);
+    free(batch->energyLoss);
+    free(batch->forceX);
+    free(batch->forceY);
+    free(batch->bounceX);
+    free(batch->bounceY);
+    free(batch->touchX);
+    free(batch->touchY);
+    free(batch->drawSizeX);
+    free(batch->drawSizeY);
+    free(batch->accX);
+    free(batch->accY);
+}
+
+void WorldBatchLoad(WorldBatch* batch, int lane, const ObjectDescriptor* objects)
+{
+    for (int id = 0; id < batch->count; id++) {
+        int i = id * WORLD_BATCH_LANES + lane;
+        ObjectDescriptor descriptor = objects[id];
+        batch->posX[i] = descriptor.pos.x;
+        batch->posY[i] = descriptor.pos.y;
+        batch->speedX[i] = descriptor.speed.x;
+        batch->speedY[i] = descriptor.speed.y;
+        batch->mass[i] = descriptor.mass;
+        batch->sizeX[i] = descriptor.size.x;
+        batch->sizeY[i] = descriptor.size.y;
+        batch->stiffness[i] = descriptor.stiffness;
+        batch->energyLoss[i] = descriptor.energyLoss;
+        batch->forceX[i] = 0;
+        batch->forceY[i] = 0;
+        batch->bounceX[i] = 0;
+        batch->bounceY[i] = 0;
+        batch->touchX[i] = 0;
+        batch->touchY[i] = 0;
+        batch->drawSizeX[i] = descriptor.size.x;
+        batch->drawSizeY[i] = descriptor.size.y;
+    }
+}
+
+void WorldBatchStep(WorldBatch* batch, float dt, Vector2 extAcceleration, float u)
+{
+    SimdBatchGravity(batch);
+    SimdBatchContactIntegrate(batch, dt, extAcceleration, u);
+    // the one kick of the step decides the bounce counters, as FinishStep does in a World
+    for (int i = 0; i < batch->count * WORLD_BATCH_LANES; i++) {
+        batch->bounceX[i] = batch->touchX[i] ? batch->bounceX[i] + 1 : 0;
+        batch->bounceY[i] = batch->touchY[i] ? batch->bounceY[i] + 1 : 0;
+        batch->touchX[i] = 0;
+        batch->touchY[i] = 0;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "world.h"
+
+#define WORLD_BATCH_LANES 16
+
+// The same small scene in WORLD_BATCH_LANES independent worlds, stepped together. Arrays are
+// indexed [id * WORLD_BATCH_LANES + lane], so one vector load holds object id of consecutive
+// worlds. A world of three objects has nothing to vectorize within itself, but across worlds every
+// lane does the same work, and walls that only some worlds touch become masks.
+//
+// A step is what WorldStep does with the defaults an ensemble uses: Euler, the symmetric direct
+// gravity sum, and wall contact, with collisions, sleeping and ccd off. It matches WorldStep
+// bit for bit where SimdContactIntegrate matches the scalar contact.
+typedef struct {
+    int count; // objects per world
+    float width;
+    float height;
+    bool implicitContact;
+
+    float* posX;
+    float* posY;
+    float* speedX;
+    float* speedY;
+    float* mass;
+    float* sizeX;
+    float* sizeY;
+    float* stiffness;
+    float* energyLoss;
+    float* forceX;
+    float* forceY;
+    int* bounceX;
+    int* bounceY;
+    int* touchX;
+    int* touchY;
+    float* drawSizeX;
+    float* drawSizeY;
+    float* accX; // gravity accumulators of one step
+    float* accY;
+} WorldBatch;
+
+void WorldBatchInit(WorldBatch* batch, int count, float width, float height);
+void WorldBatchFree(WorldBatch* batch);
+// Starts the world in lane from objects, which become ids 0..count-1 as if spawned in order.
+void WorldBatchLoad(WorldBatch* batch, int lane, const ObjectDescriptor* objects);
+void WorldBatchStep(WorldBatch* batch, float dt, Vector2 extAcceleration, float u);
+
+#endif
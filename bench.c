@@ -0,0 +1,1785 @@
+#include "math.h"
+#include "stdbool.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#include "gravity.h"
+#include "barneshut.h"
+#include "ensemble.h"
+#include "fmm.h"
+#include "particlemesh.h"
+#include "neighborlist.h"
+#include "narrowphase.h"
+#include "simd.h"
+#include "simthread.h"
+#include "threadpool.h"
+#include "world.h"
+
+// Standalone benchmarks for the physics modules. They do not open a window,
+// so they build without linking raylib: ./bench <name> [args]
+
+static double NowSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned int rngState = 0x2545F491u;
+
+static float RandomFloat(float min, float max)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return min + (max - min) * (rngState / 4294967296.0f);
+}
+
+typedef struct {
+    int count;
+    float* x;
+    float* y;
+    float* mass;
+    float* fx;
+    float* fy;
+    double* refX;
+    double* refY;
+} Bodies;
+
+static Bodies MakeBodies(int count, float width, float height)
+{
+    Bodies b;
+    b.count = count;
+    b.x = malloc(sizeof(float) * count);
+    b.y = malloc(sizeof(float) * count);
+    b.mass = malloc(sizeof(float) * count);
+    b.fx = malloc(sizeof(float) * count);
+    b.fy = malloc(sizeof(float) * count);
+    b.refX = malloc(sizeof(double) * count);
+    b.refY = malloc(sizeof(double) * count);
+    for (int i = 0; i < count; i++) {
+        b.x[i] = RandomFloat(0, width);
+        b.y[i] = RandomFloat(0, height);
+        b.mass[i] = RandomFloat(1e8, 2e9);
+    }
+    return b;
+}
+
+static void FreeBodies(Bodies* b)
+{
+    free(b->x);
+    free(b->y);
+    free(b->mass);
+    free(b->fx);
+    free(b->fy);
+    free(b->refX);
+    free(b->refY);
+}
+
+// Direct sum in double precision, the reference every solver is measured against.
+static void DirectReference(Bodies* b)
+{
+    for (int i = 0; i < b->count; i++) {
+        double ax = 0, ay = 0;
+        for (int j = 0; j < b->count; j++) {
+            if (i == j) continue;
+            double dx = b->x[j] - b->x[i];
+            double dy = b->y[j] - b->y[i];
+            double r2 = dx * dx + dy * dy;
+            double s = b->mass[j] / (r2 * sqrt(r2));
+            ax += dx * s;
+            ay += dy * s;
+        }
+        b->refX[i] = GRAVITY_CONSTANT * (double)b->mass[i] * ax;
+        b->refY[i] = GRAVITY_CONSTANT * (double)b->mass[i] * ay;
+    }
+}
+
+// The float all-pairs loop main() runs today, timed as the baseline.
+static double DirectForces(Bodies* b)
+{
+    double start = NowSeconds();
+    for (int i = 0; i < b->count; i++) {
+        float ax = 0, ay = 0;
+        for (int j = 0; j < b->count; j++) {
+            if (i == j) continue;
+            float dx = b->x[j] - b->x[i];
+            float dy = b->y[j] - b->y[i];
+            float r2 = dx * dx + dy * dy;
+            float s = b->mass[j] / (r2 * sqrtf(r2));
+            ax += dx * s;
+            ay += dy * s;
+        }
+        b->fx[i] = GRAVITY_CONSTANT * b->mass[i] * ax;
+        b->fy[i] = GRAVITY_CONSTANT * b->mass[i] * ay;
+    }
+    return NowSeconds() - start;
+}
+
+// RMS and max of |f - ref|, relative to the RMS reference force so that bodies
+// whose net force nearly cancels do not dominate.
+static void ForceError(const Bodies* b, double* rms, double* max)
+{
+    double norm = 0;
+    for (int i = 0; i < b->count; i++) {
+        norm += b->refX[i] * b->refX[i] + b->refY[i] * b->refY[i];
+    }
+    norm = sqrt(norm / b->count);
+
+    double sum = 0;
+    *max = 0;
+    for (int i = 0; i < b->count; i++) {
+        double ex = b->fx[i] - b->refX[i];
+        double ey = b->fy[i] - b->refY[i];
+        double e = sqrt(ex * ex + ey * ey) / norm;
+        sum += e * e;
+        if (e > *max) *max = e;
+    }
+    *rms = sqrt(sum / b->count);
+}
+
+static void BenchBarnesHut(int argc, char** argv)
+{
+    int counts[] = { 1000, 4000, 16000, 64000 };
+    float thetas[] = { 0.3, 0.5, 0.7, 1.0 };
+
+    printf("| N | direct (ms) | theta | Barnes-Hut (ms) | speedup | rms rel. error | max rel. error |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        Bodies b = MakeBodies(counts[c], 1200, 900);
+        DirectReference(&b);
+        double direct = DirectForces(&b);
+        for (int t = 0; t < sizeof(thetas) / sizeof(thetas[0]); t++) {
+            BarnesHut bh;
+            BarnesHutInit(&bh, thetas[t]);
+            double start = NowSeconds();
+            BarnesHutForces(&bh, b.x, b.y, b.mass, b.count, b.fx, b.fy);
+            double elapsed = NowSeconds() - start;
+            double rms, max;
+            ForceError(&b, &rms, &max);
+            printf("| %d | %.1f | %.1f | %.1f | %.1fx | %.2e | %.2e |\n",
+                b.count, direct * 1e3, thetas[t], elapsed * 1e3, direct / elapsed, rms, max);
+            BarnesHutFree(&bh);
+        }
+        FreeBodies(&b);
+    }
+}
+
+static void BenchFmm(int argc, char** argv)
+{
+    int counts[] = { 4000, 16000, 64000, 256000, 1000000 };
+    int orders[] = { 2, 4, 6, 8, 10 };
+
+    printf("| N | direct (ms) | order | FMM (ms) | speedup | rms rel. error | max rel. error |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        Bodies b = MakeBodies(counts[c], 1200, 900);
+        // past 64k the O(N^2) reference takes minutes, so only FMM timings are printed
+        bool reference = b.count <= 64000;
+        double direct = 0;
+        if (reference) {
+            DirectReference(&b);
+            direct = DirectForces(&b);
+        }
+        for (int o = 0; o < sizeof(orders) / sizeof(orders[0]); o++) {
+            Fmm fmm;
+            FmmInit(&fmm, orders[o]);
+            // the kernels are built on first use, outside the timing as they were in FmmInit
+            FmmForces(&fmm, b.x, b.y, b.mass, 1, b.fx, b.fy);
+            double start = NowSeconds();
+            FmmForces(&fmm, b.x, b.y, b.mass, b.count, b.fx, b.fy);
+            double elapsed = NowSeconds() - start;
+            if (reference) {
+                double rms, max;
+                ForceError(&b, &rms, &max);
+                printf("| %d | %.1f | %d | %.1f | %.1fx | %.2e | %.2e |\n",
+                    b.count, direct * 1e3, orders[o], elapsed * 1e3, direct / elapsed, rms, max);
+            } else {
+                printf("| %d | - | %d | %.1f | - | - | - |\n", b.count, orders[o], elapsed * 1e3);
+            }
+            FmmFree(&fmm);
+        }
+        FreeBodies(&b);
+    }
+}
+
+static void BenchParticleMesh(int argc, char** argv)
+{
+    int counts[] = { 250, 1000, 4000, 16000, 64000 };
+    struct { int gridSize; float cutoff; } configs[] = { { 128, 128 }, { 256, 64 }, { 256, 96 } };
+
+    printf("| N | direct (ms) | grid | cutoff | P3M (ms) | speedup | rms rel. error | max rel. error |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        Bodies b = MakeBodies(counts[c], 1200, 900);
+        DirectReference(&b);
+        double direct = DirectForces(&b);
+        for (int k = 0; k < sizeof(configs) / sizeof(configs[0]); k++) {
+            ParticleMesh pm;
+            ParticleMeshInit(&pm, configs[k].gridSize, configs[k].cutoff);
+            // the Green's function is cached across steps, keep its one-off cost out of the timing
+            ParticleMeshForces(&pm, 1200, 900, b.x, b.y, b.mass, b.count, b.fx, b.fy);
+            double start = NowSeconds();
+            ParticleMeshForces(&pm, 1200, 900, b.x, b.y, b.mass, b.count, b.fx, b.fy);
+            double elapsed = NowSeconds() - start;
+            double rms, max;
+            ForceError(&b, &rms, &max);
+            printf("| %d | %.1f | %d | %.0f | %.1f | %.1fx | %.2e | %.2e |\n",
+                b.count, direct * 1e3, configs[k].gridSize, pm.shortCutoff, elapsed * 1e3, direct / elapsed, rms, max);
+            ParticleMeshFree(&pm);
+        }
+        FreeBodies(&b);
+    }
+}
+
+// Logos scattered over the box, a fraction of them pressed into a wall.
+static void FillWorld(World* world, int count)
+{
+    for (int i = 0; i < count; i++) {
+        float size = RandomFloat(8, 16);
+        Vector2 pos = { RandomFloat(0, world->width), RandomFloat(0, world->height) };
+        Vector2 speed = { RandomFloat(-32, 32), RandomFloat(-32, 32) };
+        WorldSpawn(world, MakeObjectDescriptor(RandomFloat(1e8, 2e9), pos, speed, (Vector2) { size, size }, 1e12, 1e10));
+    }
+}
+
+static void CopyWorldState(World* dst, const World* src)
+{
+    int n = src->count;
+    memcpy(dst->posX, src->posX, sizeof(float) * n);
+    memcpy(dst->posY, src->posY, sizeof(float) * n);
+    memcpy(dst->speedX, src->speedX, sizeof(float) * n);
+    memcpy(dst->speedY, src->speedY, sizeof(float) * n);
+    memcpy(dst->forceX, src->forceX, sizeof(float) * n);
+    memcpy(dst->forceY, src->forceY, sizeof(float) * n);
+    memcpy(dst->bounceX, src->bounceX, sizeof(int) * n);
+    memcpy(dst->bounceY, src->bounceY, sizeof(int) * n);
+    memcpy(dst->touchX, src->touchX, sizeof(int) * n);
+    memcpy(dst->touchY, src->touchY, sizeof(int) * n);
+}
+
+static double MaxRelativeDifference(const float* a, const float* b, int count)
+{
+    double max = 0;
+    for (int i = 0; i < count; i++) {
+        double scale = fmax(fabs(a[i]), 1e-6);
+        double d = fabs((double)a[i] - b[i]) / scale;
+        if (d > max || isnan(d)) max = d;
+    }
+    return max;
+}
+
+// Checks the vector kernels against the scalar reference and times both.
+static void BenchSimd(int argc, char** argv)
+{
+    printf("kernels: %s, %d lanes\n\n", SimdName(), SimdWidth());
+    const Vector2 acceleration = { 3, -250 };
+    const float u = 0.01;
+    const float dt = 1.0 / 120.0;
+
+    int gravityCount = 4096;
+    World scalar, vector;
+    WorldInit(&scalar, gravityCount, 1200, 900);
+    WorldInit(&vector, gravityCount, 1200, 900);
+    FillWorld(&scalar, gravityCount);
+    FillWorld(&vector, 0);
+    vector.count = scalar.count;
+    memcpy(vector.mass, scalar.mass, sizeof(float) * gravityCount);
+    CopyWorldState(&vector, &scalar);
+
+    Bodies b = { .count = gravityCount, .x = scalar.posX, .y = scalar.posY, .mass = scalar.mass, .fx = vector.forceX, .fy = vector.forceY };
+    b.refX = malloc(sizeof(double) * gravityCount);
+    b.refY = malloc(sizeof(double) * gravityCount);
+    DirectReference(&b);
+    double start = NowSeconds();
+    DirectForces(&b);
+    double scalarTime = NowSeconds() - start;
+    double scalarRms, scalarMax;
+    ForceError(&b, &scalarRms, &scalarMax);
+    start = NowSeconds();
+    SimdGravityDirect(scalar.posX, scalar.posY, scalar.mass, gravityCount, 0, gravityCount, vector.forceX, vector.forceY);
+    double vectorTime = NowSeconds() - start;
+    double vectorRms, vectorMax;
+    ForceError(&b, &vectorRms, &vectorMax);
+    free(b.refX);
+    free(b.refY);
+
+    printf("| kernel | N | scalar (ms) | %s (ms) | speedup | scalar rms / max error | %s rms / max error |\n", SimdName(), SimdName());
+    printf("|---|---|---|---|---|---|---|\n");
+    printf("| gravity | %d | %.2f | %.2f | %.1fx | %.1e / %.1e | %.1e / %.1e |\n",
+        gravityCount, scalarTime * 1e3, vectorTime * 1e3, scalarTime / vectorTime, scalarRms, scalarMax, vectorRms, vectorMax);
+    WorldFree(&scalar);
+    WorldFree(&vector);
+
+    // contact: identical inputs through both paths, compared field by field after every substep,
+    // with the explicit and the implicit wall spring
+    int contactCount = 1 << 20;
+    int steps = 20;
+    for (int implicit = 0; implicit < 2; implicit++) {
+        WorldInit(&scalar, contactCount, 1200, 900);
+        WorldInit(&vector, contactCount, 1200, 900);
+        scalar.implicitContact = vector.implicitContact = implicit;
+        FillWorld(&scalar, contactCount);
+        for (int i = 0; i < contactCount; i++) {
+            scalar.forceX[i] = RandomFloat(-1e6, 1e6);
+            scalar.forceY[i] = RandomFloat(-1e6, 1e6);
+        }
+        vector.count = scalar.count;
+        memcpy(vector.mass, scalar.mass, sizeof(float) * contactCount);
+        memcpy(vector.sizeX, scalar.sizeX, sizeof(float) * contactCount);
+        memcpy(vector.sizeY, scalar.sizeY, sizeof(float) * contactCount);
+        memcpy(vector.stiffness, scalar.stiffness, sizeof(float) * contactCount);
+        memcpy(vector.energyLoss, scalar.energyLoss, sizeof(float) * contactCount);
+        CopyWorldState(&vector, &scalar);
+
+        double maxDifference = 0;
+        int touchMismatches = 0;
+        scalarTime = vectorTime = 0;
+        for (int s = 0; s < steps; s++) {
+            start = NowSeconds();
+            WorldContactIntegrate(&scalar, 0, scalar.count, dt, dt, acceleration, u);
+            scalarTime += NowSeconds() - start;
+            start = NowSeconds();
+            SimdContactIntegrate(&vector, 0, vector.count, dt, dt, acceleration, u);
+            vectorTime += NowSeconds() - start;
+
+            maxDifference = fmax(maxDifference, MaxRelativeDifference(scalar.posX, vector.posX, contactCount));
+            maxDifference = fmax(maxDifference, MaxRelativeDifference(scalar.posY, vector.posY, contactCount));
+            maxDifference = fmax(maxDifference, MaxRelativeDifference(scalar.speedX, vector.speedX, contactCount));
+            maxDifference = fmax(maxDifference, MaxRelativeDifference(scalar.speedY, vector.speedY, contactCount));
+            maxDifference = fmax(maxDifference, MaxRelativeDifference(scalar.drawSizeX, vector.drawSizeX, contactCount));
+            maxDifference = fmax(maxDifference, MaxRelativeDifference(scalar.drawSizeY, vector.drawSizeY, contactCount));
+            for (int i = 0; i < contactCount; i++) {
+                touchMismatches += scalar.touchX[i] != vector.touchX[i] || scalar.touchY[i] != vector.touchY[i];
+            }
+        }
+        printf("| %scontact x%d | %d | %.2f | %.2f | %.1fx | max rel. difference %.1e | %d wall contact mismatches |\n",
+            implicit ? "implicit " : "", steps, contactCount, scalarTime * 1e3, vectorTime * 1e3, scalarTime / vectorTime,
+            maxDifference, touchMismatches);
+        WorldFree(&scalar);
+        WorldFree(&vector);
+    }
+}
+
+static double TimeSteps(World* world, int steps)
+{
+    double start = NowSeconds();
+    for (int s = 0; s < steps; s++) {
+        WorldStep(world, 1.0 / 120.0, (Vector2) { 0, 0 }, 0.01);
+    }
+    return (NowSeconds() - start) / steps;
+}
+
+// Strong scaling: fixed N, more threads. Weak scaling: N grows so the work per thread stays
+// constant, i.e. N ~ sqrt(threads) for the O(N^2) direct sum and N ~ threads for Barnes-Hut.
+static void BenchThreads(int argc, char** argv)
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : ThreadPoolDefaultThreadCount();
+    int directCount = 8192;
+    int treeCount = 65536;
+    printf("%d hardware threads\n\n", ThreadPoolDefaultThreadCount());
+    printf("| threads | solver | strong N | step (ms) | speedup | efficiency | weak N | step (ms) | efficiency |\n");
+    printf("|---|---|---|---|---|---|---|---|---|\n");
+
+    for (int solver = 0; solver < 2; solver++) {
+        double strongBase = 0, weakBase = 0;
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            ThreadPool pool;
+            ThreadPoolInit(&pool, threads);
+            int strongCount = solver ? treeCount : directCount;
+            int weakCount = solver ? treeCount * threads : (int)(directCount * sqrt(threads));
+
+            World world;
+            WorldInit(&world, strongCount, 1200, 900);
+            world.pool = &pool;
+            world.solver = solver ? GRAVITY_SOLVER_BARNES_HUT : GRAVITY_SOLVER_DIRECT;
+            FillWorld(&world, strongCount);
+            double strong = TimeSteps(&world, 3);
+            WorldFree(&world);
+
+            WorldInit(&world, weakCount, 1200, 900);
+            world.pool = &pool;
+            world.solver = solver ? GRAVITY_SOLVER_BARNES_HUT : GRAVITY_SOLVER_DIRECT;
+            FillWorld(&world, weakCount);
+            double weak = TimeSteps(&world, 3);
+            WorldFree(&world);
+
+            if (threads == 1) {
+                strongBase = strong;
+                weakBase = weak;
+            }
+            printf("| %d | %s | %d | %.1f | %.2fx | %.0f%% | %d | %.1f | %.0f%% |\n",
+                threads, solver ? "Barnes-Hut" : "direct", strongCount, strong * 1e3, strongBase / strong,
+                100 * strongBase / (strong * threads), weakCount, weak * 1e3, 100 * weakBase / weak);
+            ThreadPoolFree(&pool);
+        }
+    }
+}
+
+// A dense cluster next to a sparse background makes Barnes-Hut walks very uneven in cost, so a
+// static split would leave threads idle. Prints what each worker did over the timed steps.
+static void BenchSteal(int argc, char** argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : ThreadPoolDefaultThreadCount();
+    int count = 65536;
+    int steps = 5;
+
+    ThreadPool pool;
+    ThreadPoolInit(&pool, threads);
+    World world;
+    WorldInit(&world, count, 1200, 900);
+    world.pool = &pool;
+    world.solver = GRAVITY_SOLVER_BARNES_HUT;
+    FillWorld(&world, count);
+    for (int i = 0; i < count / 2; i++) {
+        world.posX[i] = RandomFloat(100, 160);
+        world.posY[i] = RandomFloat(100, 160);
+    }
+
+    TimeSteps(&world, 1);
+    ThreadPoolResetStats(&pool);
+    double step = TimeSteps(&world, steps);
+    printf("N = %d, half of it in a 60x60 cluster, %d threads, %.1f ms per step\n\n", count, threads, step * 1e3);
+    printf("| worker | jobs | steals | failed steals | idle (ms per step) |\n");
+    printf("|---|---|---|---|---|\n");
+    for (int i = 0; i < pool.threadCount; i++) {
+        ThreadPoolStats stats = ThreadPoolWorkerStats(&pool, i);
+        printf("| %d | %llu | %llu | %llu | %.2f |\n", i, stats.jobs, stats.steals, stats.failedSteals, stats.idleSeconds * 1e3 / steps);
+    }
+    WorldFree(&world);
+    ThreadPoolFree(&pool);
+}
+
+// Bursts of spawns and despawns into a preallocated world. Every despawned handle must go stale
+// at once and every live handle must still find its own object at the end.
+static void BenchSpawn(int argc, char** argv)
+{
+    int capacity = argc > 1 ? atoi(argv[1]) : 1 << 18;
+    int burst = 100000;
+    int rounds = 10;
+
+    World world;
+    WorldInit(&world, capacity, 1200, 900);
+    ObjectHandle* handles = malloc(sizeof(ObjectHandle) * capacity);
+    float* tags = malloc(sizeof(float) * capacity);
+    int live = 0;
+    int wrong = 0;
+    float nextTag = 1;
+
+    printf("| round | spawned | despawned | live | spawn (ns/object) | despawn (ns/object) |\n");
+    printf("|---|---|---|---|---|---|\n");
+    for (int round = 0; round < rounds; round++) {
+        int spawned = 0;
+        double start = NowSeconds();
+        for (int i = 0; i < burst; i++) {
+            // the mass doubles as a tag to check that handles resolve to the right object
+            ObjectDescriptor descriptor = MakeObjectDescriptor(nextTag, (Vector2) { 600, 450 }, (Vector2) { 0, 0 }, (Vector2) { 4, 4 }, 1e4, 1e3);
+            ObjectHandle handle = WorldSpawn(&world, descriptor);
+            if (handle.slot < 0) break;
+            tags[live] = nextTag++;
+            handles[live++] = handle;
+            spawned += 1;
+        }
+        double spawnTime = NowSeconds() - start;
+
+        int despawned = 0;
+        int kept = 0;
+        start = NowSeconds();
+        for (int i = 0; i < live; i++) {
+            if (RandomFloat(0, 1) < 0.5f) {
+                WorldDespawn(&world, handles[i]);
+                wrong += WorldResolve(&world, handles[i]) >= 0;
+                despawned += 1;
+            } else {
+                tags[kept] = tags[i];
+                handles[kept++] = handles[i];
+            }
+        }
+        live = kept;
+        double despawnTime = NowSeconds() - start;
+
+        printf("| %d | %d | %d | %d | %.1f | %.1f |\n", round, spawned, despawned, world.count,
+            spawnTime * 1e9 / (spawned ? spawned : 1), despawnTime * 1e9 / (despawned ? despawned : 1));
+    }
+
+    for (int i = 0; i < live; i++) {
+        int id = WorldResolve(&world, handles[i]);
+        wrong += id < 0 || world.mass[id] != tags[i];
+    }
+    printf("\n%d live handles checked, %d wrong\n", live, wrong);
+
+    free(handles);
+    free(tags);
+    WorldFree(&world);
+}
+
+// One substep of the direct solver; returns its time and the force error against the double
+// precision sum over the positions the step started from.
+static double TimeDirectStep(World* world, double* rms, double* max)
+{
+    Bodies b = { .count = world->count, .x = malloc(sizeof(float) * world->count), .y = malloc(sizeof(float) * world->count), .mass = world->mass, .fx = world->forceX, .fy = world->forceY };
+    memcpy(b.x, world->posX, sizeof(float) * world->count);
+    memcpy(b.y, world->posY, sizeof(float) * world->count);
+    b.refX = malloc(sizeof(double) * world->count);
+    b.refY = malloc(sizeof(double) * world->count);
+    DirectReference(&b);
+    double step = TimeSteps(world, 1);
+    ForceError(&b, rms, max);
+    free(b.x);
+    free(b.y);
+    free(b.refX);
+    free(b.refY);
+    return step;
+}
+
+// Per-body gather against the pass that visits each pair once, scalar and vector, on one
+// thread and on the pool.
+static void BenchPairs(int argc, char** argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : ThreadPoolDefaultThreadCount();
+    int counts[] = { 1024, 4096, 8192 };
+    ThreadPool pool;
+    ThreadPoolInit(&pool, threads);
+
+    printf("| N | kernels | threads | gather (ms) | symmetric (ms) | speedup | gather rms / max error | symmetric rms / max error |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < 3; c++) {
+        for (int simd = 0; simd < 2; simd++) {
+            for (int t = 0; t < 2; t++) {
+                if (t && threads == 1) continue;
+                double time[2], rms[2], max[2];
+                for (int symmetric = 0; symmetric < 2; symmetric++) {
+                    World world;
+                    WorldInit(&world, counts[c], 1200, 900);
+                    world.simd = simd;
+                    world.symmetric = symmetric;
+                    world.pool = t ? &pool : NULL;
+                    rngState = 0x2545F491u;
+                    FillWorld(&world, counts[c]);
+                    TimeSteps(&world, 1);
+                    time[symmetric] = TimeDirectStep(&world, rms + symmetric, max + symmetric);
+                    WorldFree(&world);
+                }
+                printf("| %d | %s | %d | %.1f | %.1f | %.2fx | %.1e / %.1e | %.1e / %.1e |\n",
+                    counts[c], simd ? SimdName() : "scalar", t ? threads : 1, time[0] * 1e3, time[1] * 1e3,
+                    time[0] / time[1], rms[0], max[0], rms[1], max[1]);
+            }
+        }
+    }
+    ThreadPoolFree(&pool);
+}
+
+// Softened, cut-off sum over every pair in double precision, the reference for the list.
+static void CutoffReference(const NeighborList* nl, Bodies* b)
+{
+    double rc2 = (double)nl->cutoff * nl->cutoff;
+    double eps2 = (double)nl->softening * nl->softening;
+    for (int i = 0; i < b->count; i++) {
+        double ax = 0, ay = 0;
+        for (int j = 0; j < b->count; j++) {
+            double dx = (double)b->x[j] - b->x[i];
+            double dy = (double)b->y[j] - b->y[i];
+            double r2 = dx * dx + dy * dy;
+            if (j == i || r2 >= rc2) continue;
+            double d2 = r2 + eps2;
+            double s = b->mass[j] / (d2 * sqrt(d2));
+            ax += dx * s;
+            ay += dy * s;
+        }
+        b->refX[i] = GRAVITY_CONSTANT * (double)b->mass[i] * ax;
+        b->refY[i] = GRAVITY_CONSTANT * (double)b->mass[i] * ay;
+    }
+}
+
+// Cut-off solver at constant density (the box grows with N): cost per step, how often the
+// Verlet list is rebuilt, and the error of the last step against the all-pairs sum.
+static void BenchNeighbors(int argc, char** argv)
+{
+    int counts[] = { 4000, 16000, 64000 };
+    int steps = 120;
+    printf("| N | box | direct (ms) | cutoff (ms) | speedup | rebuilds | listed neighbors per body | rms rel. error | max rel. error |\n");
+    printf("|---|---|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < 3; c++) {
+        int count = counts[c];
+        float scale = sqrtf(count / 4000.0f);
+        World world;
+        WorldInit(&world, count, 1200 * scale, 900 * scale);
+        world.solver = GRAVITY_SOLVER_CUTOFF;
+        // light bodies clear of the walls: a swarm that clumps slowly instead of FillWorld's
+        // heavy logos that hit the walls at once
+        for (int i = 0; i < count; i++) {
+            Vector2 pos = { RandomFloat(32, world.width - 32), RandomFloat(32, world.height - 32) };
+            Vector2 speed = { RandomFloat(-32, 32), RandomFloat(-32, 32) };
+            WorldSpawn(&world, MakeObjectDescriptor(RandomFloat(1e6, 1e7), pos, speed, (Vector2) { 4, 4 }, 1e8, 1e6));
+        }
+
+        NeighborList* nl = &world.neighborList;
+        nl->builds = 0;
+        double step = TimeSteps(&world, steps - 1);
+
+        double rms = -1, max = -1;
+        if (count <= 16000) {
+            Bodies b = { .count = count, .x = malloc(sizeof(float) * count), .y = malloc(sizeof(float) * count), .mass = world.mass, .fx = world.forceX, .fy = world.forceY };
+            memcpy(b.x, world.posX, sizeof(float) * count);
+            memcpy(b.y, world.posY, sizeof(float) * count);
+            b.refX = malloc(sizeof(double) * count);
+            b.refY = malloc(sizeof(double) * count);
+            CutoffReference(nl, &b);
+            TimeSteps(&world, 1);
+            ForceError(&b, &rms, &max);
+            free(b.x);
+            free(b.y);
+            free(b.refX);
+            free(b.refY);
+        } else {
+            TimeSteps(&world, 1);
+        }
+
+        // last, its close encounters would scatter the swarm
+        double direct = -1;
+        if (count <= 16000) {
+            world.solver = GRAVITY_SOLVER_DIRECT;
+            direct = TimeSteps(&world, 1);
+        }
+
+        char directText[32], speedupText[32], rmsText[32], maxText[32];
+        snprintf(directText, 32, direct < 0 ? "-" : "%.1f", direct * 1e3);
+        snprintf(speedupText, 32, direct < 0 ? "-" : "%.0fx", direct / step);
+        snprintf(rmsText, 32, rms < 0 ? "-" : "%.2e", rms);
+        snprintf(maxText, 32, max < 0 ? "-" : "%.2e", max);
+        printf("| %d | %.0fx%.0f | %s | %.2f | %s | %d / %d | %.1f | %s | %s |\n", count, world.width, world.height,
+            directText, step * 1e3, speedupText, nl->builds, steps, (double)nl->start[count] / count, rmsText, maxText);
+        WorldFree(&world);
+    }
+}
+
+// Logos of similar size spread so each overlaps about one other on average.
+static void FillSwarm(World* world, int count, float minSize, float maxSize)
+{
+    for (int i = 0; i < count; i++) {
+        float size = RandomFloat(minSize, maxSize);
+        Vector2 pos = { RandomFloat(0, world->width), RandomFloat(0, world->height) };
+        Vector2 speed = { RandomFloat(-32, 32), RandomFloat(-32, 32) };
+        WorldSpawn(world, MakeObjectDescriptor(RandomFloat(1e6, 1e7), pos, speed, (Vector2) { size, size }, 1e8, 1e6));
+    }
+}
+
+static int CountPairs(const World* world)
+{
+    int pairs = 0;
+    for (int w = 0; w < world->pairListCount; w++) {
+        pairs += world->pairLists[w].count;
+    }
+    return pairs;
+}
+
+// Overlapping pairs by testing every pair; returns how many the broadphase pairs missed, and
+// sets found to the number of true pairs.
+static int BruteForceMissed(const World* world, int* found)
+{
+    char* marked = calloc((size_t)world->count * world->count, 1);
+    for (int w = 0; w < world->pairListCount; w++) {
+        for (int p = 0; p < world->pairLists[w].count; p++) {
+            BodyPair pair = world->pairLists[w].pairs[p];
+            marked[(size_t)pair.a * world->count + pair.b] = 1;
+        }
+    }
+    int missed = 0;
+    *found = 0;
+    for (int i = 0; i < world->count; i++) {
+        for (int j = i + 1; j < world->count; j++) {
+            if (fabsf(world->posX[i] - world->posX[j]) >= world->sizeX[i] + world->sizeX[j]) continue;
+            if (fabsf(world->posY[i] - world->posY[j]) >= world->sizeY[i] + world->sizeY[j]) continue;
+            *found += 1;
+            missed += !marked[(size_t)i * world->count + j];
+        }
+    }
+    free(marked);
+    return missed;
+}
+
+// Spatial hash broadphase: build and pair-finding time on one thread and on the pool, bucket
+// occupancy, and a brute-force check of the pair set for the smallest scene.
+static void BenchGrid(int argc, char** argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : ThreadPoolDefaultThreadCount();
+    int counts[] = { 10000, 100000, 1000000 };
+    ThreadPool pool;
+    ThreadPoolInit(&pool, threads);
+
+    // the first call finds the objects in spawn order and sorts them into grid order, the
+    // later ones are the steady state
+    printf("| N | threads | first call (ms) | build (ms) | pairs (ms) | pairs | buckets | occupied | mean / max occupancy | missed |\n");
+    printf("|---|---|---|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < 3; c++) {
+        int count = counts[c];
+        // ~100 px^2 of box per logo of radius 2..4
+        float side = sqrtf(100.0f * count);
+        World world;
+        WorldInit(&world, count, side, side);
+        FillSwarm(&world, count, 2, 4);
+        for (int t = 0; t < 2; t++) {
+            if (t && threads == 1) continue;
+            world.pool = t ? &pool : NULL;
+            world.reorderCountdown = 0;
+            double start = NowSeconds();
+            WorldFindPairs(&world);
+            double first = NowSeconds() - start;
+            start = NowSeconds();
+            SpatialHashBuild(&world.grid, world.posX, world.posY, world.sizeX, world.sizeY, world.count);
+            double build = NowSeconds() - start;
+            start = NowSeconds();
+            WorldFindPairs(&world);
+            double total = NowSeconds() - start;
+
+            char missedText[32] = "-";
+            if (count <= 10000) {
+                int found;
+                int missed = BruteForceMissed(&world, &found);
+                snprintf(missedText, 32, "%d of %d", missed, found);
+            }
+            SpatialHashStats stats = world.grid.stats;
+            printf("| %d | %d | %.2f | %.2f | %.2f | %d | %d | %d | %.2f / %d | %s |\n", count, t ? threads : 1,
+                first * 1e3, build * 1e3, (total - build) * 1e3, CountPairs(&world), stats.buckets, stats.occupied,
+                stats.meanOccupancy, stats.maxOccupancy, missedText);
+        }
+        WorldFree(&world);
+    }
+
+    printf("\noccupancy histogram of the last build:");
+    World world;
+    WorldInit(&world, counts[2], sqrtf(100.0f * counts[2]), sqrtf(100.0f * counts[2]));
+    FillSwarm(&world, counts[2], 2, 4);
+    WorldFindPairs(&world);
+    for (int k = 0; k < SPATIAL_HASH_HISTOGRAM; k++) {
+        printf(" %d%s: %d", k, k == SPATIAL_HASH_HISTOGRAM - 1 ? "+" : "", world.grid.stats.histogram[k]);
+    }
+    printf("\n");
+    WorldFree(&world);
+    ThreadPoolFree(&pool);
+}
+
+// Mostly small logos with a few huge ones, spread uniformly or in tight clusters.
+static void FillMixed(World* world, int count, bool clustered)
+{
+    float centerX[16], centerY[16];
+    for (int c = 0; c < 16; c++) {
+        centerX[c] = RandomFloat(0.1f, 0.9f) * world->width;
+        centerY[c] = RandomFloat(0.1f, 0.9f) * world->height;
+    }
+    float spread = world->width / 16;
+    for (int i = 0; i < count; i++) {
+        float size = RandomFloat(0, 1) < 0.02f ? RandomFloat(50, 200) : RandomFloat(2, 8);
+        Vector2 pos = { RandomFloat(0, world->width), RandomFloat(0, world->height) };
+        if (clustered) {
+            int c = i % 16;
+            pos.x = centerX[c] + spread * (RandomFloat(-1, 1) + RandomFloat(-1, 1));
+            pos.y = centerY[c] + spread * (RandomFloat(-1, 1) + RandomFloat(-1, 1));
+        }
+        WorldSpawn(world, MakeObjectDescriptor(RandomFloat(1e6, 1e7), pos, (Vector2) { 0, 0 }, (Vector2) { size, size }, 1e8, 1e6));
+    }
+}
+
+static double TimeFindPairs(World* world)
+{
+    double start = NowSeconds();
+    WorldFindPairs(world);
+    return NowSeconds() - start;
+}
+
+// Grid against tree on mixed sizes, with a brute-force pair test as the baseline, then the
+// tree's incremental update after small and large moves and a check of its box queries.
+static void BenchTree(int argc, char** argv)
+{
+    int counts[] = { 10000, 100000 };
+    printf("| N | layout | brute force (ms) | grid (ms) | tree build (ms) | tree update (ms) | pairs | grid / tree missed |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < 2; c++) {
+        for (int clustered = 0; clustered < 2; clustered++) {
+            int count = counts[c];
+            float side = sqrtf(400.0f * count);
+            World world;
+            WorldInit(&world, count, side, side);
+            world.reorderInterval = 0;
+            FillMixed(&world, count, clustered);
+
+            double grid = TimeFindPairs(&world);
+            int gridPairs = CountPairs(&world);
+            char brute[32] = "-", missed[32] = "-";
+            if (count <= 10000) {
+                int found;
+                double start = NowSeconds();
+                int gridMissed = BruteForceMissed(&world, &found);
+                snprintf(brute, 32, "%.1f", (NowSeconds() - start) * 1e3);
+                world.broadphase = BROADPHASE_TREE;
+                TimeFindPairs(&world);
+                snprintf(missed, 32, "%d / %d of %d", gridMissed, BruteForceMissed(&world, &found), found);
+            }
+
+            world.broadphase = BROADPHASE_TREE;
+            AabbTreeFree(&world.tree);
+            AabbTreeInit(&world.tree, 4);
+            double build = TimeFindPairs(&world);
+            double update = TimeFindPairs(&world);
+            int treePairs = CountPairs(&world);
+            printf("| %d | %s | %s | %.2f | %.2f | %.2f | %d / %d | %s |\n", count, clustered ? "clustered" : "uniform",
+                brute, grid * 1e3, build * 1e3, update * 1e3, gridPairs, treePairs, missed);
+            WorldFree(&world);
+        }
+    }
+
+    // incremental updates: moves within the 4 px margin leave the tree alone
+    int count = 100000;
+    float side = sqrtf(400.0f * count);
+    World world;
+    WorldInit(&world, count, side, side);
+    world.broadphase = BROADPHASE_TREE;
+    FillMixed(&world, count, false);
+    WorldFindPairs(&world);
+    printf("\n| move (px) | update + pairs (ms) | reinserted leaves |\n|---|---|---|\n");
+    float moves[] = { 1, 3, 8 };
+    for (int m = 0; m < 3; m++) {
+        for (int i = 0; i < count; i++) {
+            world.posX[i] += RandomFloat(-moves[m], moves[m]) / sqrtf(2);
+            world.posY[i] += RandomFloat(-moves[m], moves[m]) / sqrtf(2);
+        }
+        double time = TimeFindPairs(&world);
+        printf("| %.0f | %.2f | %d |\n", moves[m], time * 1e3, world.tree.reinserted);
+        // back to where the margins were fitted
+        AabbTreeFree(&world.tree);
+        AabbTreeInit(&world.tree, 4);
+        WorldFindPairs(&world);
+    }
+
+    int wrong = 0;
+    int keys[4096];
+    for (int q = 0; q < 1000; q++) {
+        float x = RandomFloat(0, side), y = RandomFloat(0, side), r = RandomFloat(1, 100);
+        Aabb box = { x - r, y - r, x + r, y + r };
+        int found = AabbTreeQuery(&world.tree, box, keys, 4096);
+        int expected = 0;
+        for (int i = 0; i < count; i++) {
+            expected += world.posX[i] - world.sizeX[i] < box.maxX && box.minX < world.posX[i] + world.sizeX[i]
+                && world.posY[i] - world.sizeY[i] < box.maxY && box.minY < world.posY[i] + world.sizeY[i];
+        }
+        wrong += found != expected;
+    }
+    printf("\n1000 box queries against a linear scan, %d wrong\n", wrong);
+    WorldFree(&world);
+}
+
+// Drops round logos into a narrow box under gravity and lets them settle into a pile with object
+// contact on. Reports cost per substep and whether the pile comes to rest without blowing up.
+static void BenchPile(int argc, char** argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : ThreadPoolDefaultThreadCount();
+    int counts[] = { 1000, 4000 };
+    const float dt = 1.0 / 120.0;
+    const Vector2 acceleration = { 0, -100 };
+    int steps = 3000;
+    ThreadPool pool;
+    ThreadPoolInit(&pool, threads);
+
+    printf("| N | threads | step (ms) | pairs | max speed | mean speed | deepest overlap / radius | NaN |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < 2; c++) {
+        for (int t = 0; t < 2; t++) {
+            if (t && threads == 1) continue;
+            int count = counts[c];
+            float width = 12 * sqrtf(count) * 2;
+            World world;
+            WorldInit(&world, count, width, 4 * width);
+            world.pool = t ? &pool : NULL;
+            world.collisions = true;
+            world.solver = GRAVITY_SOLVER_CUTOFF; // keeps the pile cheap; the weight comes from acceleration
+            rngState = 0x2545F491u;
+            for (int i = 0; i < count; i++) {
+                float size = RandomFloat(5, 7);
+                Vector2 pos = { RandomFloat(size, width - size), RandomFloat(size, 4 * width - size) };
+                Vector2 speed = { RandomFloat(-8, 8), RandomFloat(-8, 8) };
+                // explicit steps: a logo touching six others must keep sqrt(6 k / m) * dt and
+                // 6 c / m * dt well below 2, with k and c the series values (half of these)
+                WorldSpawn(&world, MakeObjectDescriptor(1e6, pos, speed, (Vector2) { size, size }, 4e9, 4e7));
+            }
+            // gravity between logos is negligible next to the box's acceleration
+            world.neighborList.cutoff = 0;
+
+            double start = NowSeconds();
+            for (int s = 0; s < steps; s++) {
+                WorldStep(&world, dt, acceleration, 0.01);
+            }
+            double step = (NowSeconds() - start) / steps;
+
+            double maxSpeed = 0, meanSpeed = 0, deepest = 0;
+            int nans = 0;
+            for (int i = 0; i < count; i++) {
+                double speed = hypot(world.speedX[i], world.speedY[i]);
+                nans += isnan(speed) || isnan(world.posX[i]) || isnan(world.posY[i]);
+                maxSpeed = fmax(maxSpeed, speed);
+                meanSpeed += speed / count;
+            }
+            for (int w = 0; w < world.pairListCount; w++) {
+                for (int p = 0; p < world.pairLists[w].count; p++) {
+                    BodyPair pair = world.pairLists[w].pairs[p];
+                    double d = hypot(world.posX[pair.b] - world.posX[pair.a], world.posY[pair.b] - world.posY[pair.a]);
+                    double depth = world.sizeX[pair.a] + world.sizeX[pair.b] - d;
+                    deepest = fmax(deepest, depth / fmin(world.sizeX[pair.a], world.sizeX[pair.b]));
+                }
+            }
+            printf("| %d | %d | %.2f | %d | %.2f | %.3f | %.3f | %d |\n", count, t ? threads : 1, step * 1e3,
+                CountPairs(&world), maxSpeed, meanSpeed, deepest, nans);
+            WorldFree(&world);
+        }
+    }
+    ThreadPoolFree(&pool);
+}
+
+// Small heaps of round logos spread along a wide floor, each its own island once settled. Every
+// heap starts as a loose stack, three logos wide.
+static void FillHeaps(World* world, int heaps, int perHeap, float spacing)
+{
+    rngState = 0x2545F491u;
+    for (int h = 0; h < heaps; h++) {
+        for (int i = 0; i < perHeap; i++) {
+            float size = RandomFloat(5, 7);
+            Vector2 pos = { (h + 0.5f) * spacing + (i % 3 - 1) * 15 + RandomFloat(-1, 1), 8 + i / 3 * 15 };
+            WorldSpawn(world, MakeObjectDescriptor(1e6, pos, (Vector2) { 0, 0 }, (Vector2) { size, size }, 4e9, 4e7));
+        }
+    }
+}
+
+// Settles the heaps with sleeping off and on, then drops one logo onto the first heap. Reports
+// the settled substep cost and how much of the world the drop wakes.
+static void BenchSleep(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    const float dt = 1.0 / 120.0;
+    const Vector2 acceleration = { 0, -100 };
+    int heaps = 256, perHeap = 16;
+    float spacing = 400;
+
+    printf("| sleeping | N | settle steps | awake | settled step (ms) | awake after drop | step after drop (ms) | islands woken |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (int on = 0; on < 2; on++) {
+        World world;
+        WorldInit(&world, heaps * perHeap + 1, heaps * spacing, 200);
+        world.collisions = true;
+        world.sleeping = on;
+        world.solver = GRAVITY_SOLVER_CUTOFF;
+        world.neighborList.cutoff = 0;
+        FillHeaps(&world, heaps, perHeap, spacing);
+
+        int settle = 0;
+        for (; settle < 3000; settle++) {
+            WorldStep(&world, dt, acceleration, 0.01);
+            if (on && world.awakeCount == 0) break;
+        }
+        int awake = world.awakeCount;
+        double start = NowSeconds();
+        for (int s = 0; s < 240; s++) {
+            WorldStep(&world, dt, acceleration, 0.01);
+        }
+        double settled = (NowSeconds() - start) / 240;
+
+        // straight above the top logo of the first heap
+        int top = 0;
+        for (int i = 0; i < world.count; i++) {
+            if (world.posX[i] < spacing && world.posY[i] > world.posY[top]) top = i;
+        }
+        int wakes = world.wakes;
+        Vector2 pos = { world.posX[top], world.posY[top] + 30 };
+        WorldSpawn(&world, MakeObjectDescriptor(1e6, pos, (Vector2) { 0, -50 }, (Vector2) { 6, 6 }, 4e9, 4e7));
+        int peak = 0;
+        start = NowSeconds();
+        for (int s = 0; s < 240; s++) {
+            WorldStep(&world, dt, acceleration, 0.01);
+            peak = world.awakeCount > peak ? world.awakeCount : peak;
+        }
+        double dropped = (NowSeconds() - start) / 240;
+        printf("| %s | %d | %d | %d | %.3f | %d | %.3f | %d |\n", on ? "on" : "off", world.count, settle, awake,
+            settled * 1e3, peak, dropped * 1e3, world.wakes - wakes);
+        WorldFree(&world);
+    }
+}
+
+static double KineticEnergy(const World* world)
+{
+    double energy = 0;
+    for (int i = 0; i < world->count; i++) {
+        energy += 0.5 * world->mass[i] * (world->speedX[i] * world->speedX[i] + world->speedY[i] * world->speedY[i]);
+    }
+    return energy;
+}
+
+// A gas of fast logos in a closed box, one second of 60 frames at several substep counts. Reports
+// the energy left (the dampers only ever remove it, so more than 1 is the penalty contact blowing
+// up), the deepest any logo got into a wall or another logo, and the logos that left the box.
+static void BenchCcd(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    int count = 1000;
+    float width = 12 * sqrtf(count) * 2;
+    int substepCounts[] = { 1, 2, 4, 8 };
+
+    printf("| ccd | substeps | step (ms) | energy left | deepest in wall / radius | deepest overlap / radius | escaped | NaN |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < 4; c++) {
+        for (int on = 0; on < 2; on++) {
+            int substeps = substepCounts[c];
+            float dt = 1.0f / 60 / substeps;
+            World world;
+            WorldInit(&world, count, width, width);
+            world.collisions = true;
+            world.ccd = on;
+            world.solver = GRAVITY_SOLVER_CUTOFF;
+            world.neighborList.cutoff = 0;
+            rngState = 0x2545F491u;
+            for (int i = 0; i < count; i++) {
+                // a lattice, so nothing starts out overlapping
+                Vector2 pos = { (i % 32 + 0.5f) * width / 32, (i / 32 + 0.5f) * width / 32 };
+                Vector2 speed = { RandomFloat(-1500, 1500), RandomFloat(-1500, 1500) };
+                WorldSpawn(&world, MakeObjectDescriptor(1e6, pos, speed, (Vector2) { 6, 6 }, 4e9, 4e6));
+            }
+            double before = KineticEnergy(&world);
+
+            double wall = 0, overlap = 0, elapsed = 0;
+            for (int s = 0; s < 60 * substeps; s++) {
+                double start = NowSeconds();
+                WorldStep(&world, dt, (Vector2) { 0, 0 }, 0);
+                elapsed += NowSeconds() - start;
+                for (int i = 0; i < world.count; i++) {
+                    float x = world.posX[i], y = world.posY[i], size = world.sizeX[i];
+                    double depth = fmax(fmax(size - x, x + size - width), fmax(size - y, y + size - width));
+                    wall = fmax(wall, depth / size);
+                }
+                for (int w = 0; w < world.pairListCount; w++) {
+                    for (int p = 0; p < world.pairLists[w].count; p++) {
+                        BodyPair pair = world.pairLists[w].pairs[p];
+                        double d = hypot(world.posX[pair.b] - world.posX[pair.a], world.posY[pair.b] - world.posY[pair.a]);
+                        overlap = fmax(overlap, (world.sizeX[pair.a] + world.sizeX[pair.b] - d) / world.sizeX[pair.a]);
+                    }
+                }
+            }
+            int escaped = 0, nans = 0;
+            for (int i = 0; i < world.count; i++) {
+                nans += isnan(world.posX[i]) || isnan(world.posY[i]);
+                escaped += world.posX[i] < 0 || world.posX[i] > width || world.posY[i] < 0 || world.posY[i] > width;
+            }
+            printf("| %s | %d | %.3f | %.3f | %.2f | %.2f | %d | %d |\n", on ? "on" : "off", substeps, elapsed / (60 * substeps) * 1e3,
+                KineticEnergy(&world) / before, wall, overlap, escaped, nans);
+            WorldFree(&world);
+        }
+    }
+}
+
+// Stiff logos (k / m = 1e4) dropped from random heights into an 800 x 600 box, collisions off:
+// long free flights broken by short floor contacts. The springs keep the landings shallow and
+// the logos start away from the side walls, since deep or corner contacts make runs chaotic.
+static void FillDrop(World* world, int count)
+{
+    rngState = 0x2545F491u;
+    for (int i = 0; i < count; i++) {
+        float size = RandomFloat(8, 16);
+        Vector2 pos = { RandomFloat(200, 600), RandomFloat(100, 600 - size) };
+        Vector2 speed = { RandomFloat(-32, 32), RandomFloat(-32, 32) };
+        WorldSpawn(world, MakeObjectDescriptor(1e9, pos, speed, (Vector2) { size, size }, 1e13, 3e10));
+    }
+}
+
+// Fixed steps against the error controller over four seconds of the drop. Every adaptive try
+// costs three WorldStep calls. The error is the largest distance from a run with 64 times finer
+// fixed steps. One dt serves the whole world, so the more logos, the more often one of them is
+// in contact and holds everybody to small steps.
+static void BenchAdaptive(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    int counts[] = { 1, 4, 64 };
+    const float duration = 4;
+    const Vector2 acceleration = { 0, -250 };
+    float fixedDts[] = { 1.0 / 60, 1.0 / 120, 1.0 / 480 };
+    float tolerances[] = { 0.5, 0.05, 0.005 };
+
+    printf("| logos | stepping | steps | rejected | step calls | time (ms) | max error (px) |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    for (int c = 0; c < 3; c++) {
+        int count = counts[c];
+        World reference;
+        WorldInit(&reference, count, 800, 600);
+        reference.solver = GRAVITY_SOLVER_CUTOFF;
+        reference.neighborList.cutoff = 0;
+        FillDrop(&reference, count);
+        for (int s = 0; s < 120 * 64 * duration; s++) {
+            WorldStep(&reference, 1.0 / (120 * 64), acceleration, 0.01);
+        }
+
+        for (int run = 0; run < 6; run++) {
+            bool adaptive = run >= 3;
+            World world;
+            WorldInit(&world, count, 800, 600);
+            world.solver = GRAVITY_SOLVER_CUTOFF;
+            world.neighborList.cutoff = 0;
+            FillDrop(&world, count);
+
+            int steps = 0;
+            double start = NowSeconds();
+            if (adaptive) {
+                world.adaptiveTolerance = tolerances[run - 3];
+                for (float t = 0; duration - t > 1e-6f; steps++) {
+                    t += WorldStepAdaptive(&world, duration - t, acceleration, 0.01);
+                }
+            } else {
+                for (; steps < duration / fixedDts[run] + 0.5f; steps++) {
+                    WorldStep(&world, fixedDts[run], acceleration, 0.01);
+                }
+            }
+            double elapsed = NowSeconds() - start;
+
+            // collisions are off, so ids never move
+            double error = 0;
+            for (int i = 0; i < count; i++) {
+                error = fmax(error, hypot(world.posX[i] - reference.posX[i], world.posY[i] - reference.posY[i]));
+            }
+            if (adaptive) {
+                printf("| %d | adaptive, tolerance %g px | %d | %d | %d | %.2f | %.3f |\n", count, tolerances[run - 3], steps,
+                    world.rejected, 3 * (steps + world.rejected), elapsed * 1e3, error);
+            } else {
+                printf("| %d | fixed, dt 1/%.0f | %d | 0 | %d | %.2f | %.3f |\n", count, 1 / fixedDts[run], steps, steps,
+                    elapsed * 1e3, error);
+            }
+            WorldFree(&world);
+        }
+        WorldFree(&reference);
+    }
+}
+
+// Drops one logo onto the floor with substeps of dt and returns how high its bottom gets after
+// the first bounce, or NAN when the contact blows up.
+static double BounceHeight(float stiffness, float energyLoss, bool implicit, double dt)
+{
+    World world;
+    WorldInit(&world, 1, 800, 600);
+    world.solver = GRAVITY_SOLVER_CUTOFF;
+    world.neighborList.cutoff = 0;
+    world.implicitContact = implicit;
+    WorldSpawn(&world, MakeObjectDescriptor(1e9, (Vector2) { 400, 300 }, (Vector2) { 0, 0 }, (Vector2) { 12, 12 }, stiffness, energyLoss));
+    bool bounced = false;
+    double height = NAN;
+    for (double t = 0; t < 4; t += dt) {
+        WorldStep(&world, dt, (Vector2) { 0, -250 }, 0);
+        if (!isfinite(world.posY[0]) || world.posY[0] > 600) break;
+        bounced = bounced || world.bounceY[0] > 0;
+        if (bounced && world.bounceY[0] == 0 && world.speedY[0] <= 0) {
+            height = world.posY[0] - world.sizeY[0];
+            break;
+        }
+    }
+    WorldFree(&world);
+    return height;
+}
+
+// Substeps per 1/60 s frame, in powers of two, for a bounce within 2% of a run with
+// sqrt(k / m) * dt = 0.01, with the explicit and the implicit wall spring. The damping ratio is
+// 0.1 at every stiffness. Also the fewest substeps at which the explicit spring stays stable,
+// and what the implicit one does with a single substep per frame.
+static void BenchSubsteps(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    float stiffnesses[] = { 1e12, 1e13, 1e14, 1e15, 1e16 };
+    const float mass = 1e9;
+    printf("| k / m | reference bounce (px) | explicit: stable from | explicit: within 2%% | implicit: bounce at 1 substep (px) | implicit: within 2%% |\n");
+    printf("|---|---|---|---|---|---|\n");
+    for (int s = 0; s < 5; s++) {
+        float k = stiffnesses[s];
+        float c = 0.2f * sqrtf(k * mass);
+        double reference = BounceHeight(k, c, false, 0.01 / sqrt(k / mass));
+        int stable = -1;
+        int needed[2] = { -1, -1 };
+        for (int implicit = 0; implicit < 2; implicit++) {
+            for (int substeps = 1; substeps <= 1 << 16 && needed[implicit] < 0; substeps *= 2) {
+                double height = BounceHeight(k, c, implicit, 1.0 / 60 / substeps);
+                // stable: it does not come back higher than it was dropped from
+                if (!implicit && stable < 0 && height < 300 - 12) stable = substeps;
+                if (fabs(height - reference) <= 0.02 * reference) needed[implicit] = substeps;
+            }
+        }
+        printf("| %.0e | %.1f | %d | %d | %.1f | %d |\n", k / mass, reference, stable, needed[0],
+            BounceHeight(k, c, true, 1.0 / 60), needed[1]);
+    }
+}
+
+static const char* integratorNames[] = { "euler", "leapfrog", "verlet", "yoshida4" };
+
+// Relative energy error and closure of a planet on an eccentric orbit (a = 300 px, e = 0.6,
+// period 4 s) around a sun, after ten periods from apoapsis with substeps of dt. Closure is how
+// far from its start the planet ends up, in px; NAN once it escaped.
+static void Orbit(Integrator integrator, double dt, double* energyError, double* closure, int* evaluations)
+{
+    const float sunMass = 1e11, planetMass = 1e8;
+    const double a = 300, e = 0.6;
+    double mu = GRAVITY_CONSTANT * ((double)sunMass + planetMass);
+    double apoapsis = a * (1 + e);
+    double speed = sqrt(mu * (1 - e) / apoapsis);
+    double period = 2 * PI * sqrt(a * a * a / mu);
+    World world;
+    WorldInit(&world, 2, 1100, 1100);
+    world.integrator = integrator;
+    // the center of mass stays put in the middle of the box
+    float share = planetMass / (sunMass + planetMass);
+    WorldSpawn(&world, MakeObjectDescriptor(sunMass, (Vector2) { 550 - apoapsis * share, 550 },
+        (Vector2) { 0, -speed * share }, (Vector2) { 5, 5 }, 1e13, 0));
+    WorldSpawn(&world, MakeObjectDescriptor(planetMass, (Vector2) { 550 + apoapsis * (1 - share), 550 },
+        (Vector2) { 0, speed * (1 - share) }, (Vector2) { 5, 5 }, 1e13, 0));
+
+    double energy0 = -GRAVITY_CONSTANT * sunMass * planetMass / apoapsis
+        + 0.5 * planetMass * speed * speed * (1 - share);
+    *energyError = 0;
+    int steps = (int)round(10 * period / dt);
+    for (int n = 0; n < steps; n++) {
+        WorldStep(&world, dt, (Vector2) { 0, 0 }, 0);
+        double dx = world.posX[1] - world.posX[0], dy = world.posY[1] - world.posY[0];
+        double kinetic = 0;
+        for (int i = 0; i < 2; i++) {
+            kinetic += 0.5 * world.mass[i] * ((double)world.speedX[i] * world.speedX[i] + (double)world.speedY[i] * world.speedY[i]);
+        }
+        double energy = kinetic - GRAVITY_CONSTANT * sunMass * planetMass / sqrt(dx * dx + dy * dy);
+        *energyError = fmax(*energyError, fabs(energy - energy0) / fabs(energy0));
+    }
+    double dx = world.posX[1] - world.posX[0] - apoapsis, dy = world.posY[1] - world.posY[0];
+    *closure = sqrt(dx * dx + dy * dy) < apoapsis ? sqrt(dx * dx + dy * dy) : NAN;
+    *evaluations = world.forceEvaluations;
+    WorldFree(&world);
+}
+
+// Every integrator on the same orbit at 1 to 64 substeps per 1/60 s frame, with the force passes
+// that cost, then the fewest substeps that keep the orbit closed: energy within 1e-3 and back
+// within 2 px of the start. Float positions put a floor of about 1e-4 under the energy error.
+static void BenchIntegrators(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    int fewest[INTEGRATOR_COUNT];
+    printf("| integrator | substeps | force passes / s | max energy error | closure after 10 orbits (px) |\n");
+    printf("|---|---|---|---|---|\n");
+    for (int integrator = 0; integrator < INTEGRATOR_COUNT; integrator++) {
+        fewest[integrator] = -1;
+        for (int substeps = 1; substeps <= 64; substeps *= 2) {
+            double energyError, closure;
+            int evaluations;
+            Orbit(integrator, 1.0 / 60 / substeps, &energyError, &closure, &evaluations);
+            if (fewest[integrator] < 0 && energyError <= 1e-3 && closure <= 2) fewest[integrator] = substeps;
+            printf("| %s | %d | %.0f | %.1e | %.2f |\n", integratorNames[integrator], substeps,
+                evaluations / 40.0, energyError, closure);
+        }
+    }
+    printf("\n| integrator | substeps for a closed orbit | force passes / s |\n");
+    printf("|---|---|---|\n");
+    int passes[] = { 1, 1, 1, 3 };
+    for (int integrator = 0; integrator < INTEGRATOR_COUNT; integrator++) {
+        if (fewest[integrator] < 0) {
+            printf("| %s | > 64 | > %d |\n", integratorNames[integrator], 64 * 60 * passes[integrator]);
+        } else {
+            printf("| %s | %d | %d |\n", integratorNames[integrator], fewest[integrator], fewest[integrator] * 60 * passes[integrator]);
+        }
+    }
+}
+
+// A heavy sun in the middle of a 4000 px box with light planets on circular orbits from 80 to
+// 1500 px, so the inner ones feel a thousand times the outer ones' acceleration, and a few logos
+// bouncing on the floor.
+static void FillDisc(World* world, int planets, ObjectHandle* handles)
+{
+    rngState = 0x2545F491u;
+    const float sunMass = 1e11;
+    handles[0] = WorldSpawn(world, MakeObjectDescriptor(sunMass, (Vector2) { 2000, 2000 }, (Vector2) { 0, 0 }, (Vector2) { 20, 20 }, 1e13, 0));
+    for (int i = 1; i <= planets; i++) {
+        float r = RandomFloat(80, 1500), angle = RandomFloat(0, 2 * PI);
+        float speed = sqrtf(GRAVITY_CONSTANT * sunMass / r);
+        Vector2 pos = { 2000 + r * cosf(angle), 2000 + r * sinf(angle) };
+        handles[i] = WorldSpawn(world, MakeObjectDescriptor(1e3, pos, (Vector2) { -speed * sinf(angle), speed * cosf(angle) }, (Vector2) { 4, 4 }, 1e7, 2e4));
+    }
+    for (int i = planets + 1; i <= planets + 12; i++) {
+        Vector2 pos = { 200 + 300 * (i - planets), 60 };
+        handles[i] = WorldSpawn(world, MakeObjectDescriptor(1e6, pos, (Vector2) { 0, -300 }, (Vector2) { 10, 10 }, 1e10, 2e7));
+    }
+}
+
+// Two seconds of the disc with steps of 1/60 s split 16 ways, against a uniform run with four
+// times smaller steps: uniform steps of three sizes and block steps at three accuracies.
+// Object-steps count the kicks of single objects; saved is against uniform dt / 16.
+static void BenchBlocks(int argc, char** argv)
+{
+    int planets = argc > 1 ? atoi(argv[1]) : 500;
+    int count = planets + 13;
+    const float dt = 1.0 / 60;
+    const int levels = 4, blocks = 120;
+    ObjectHandle* handles = malloc(sizeof(ObjectHandle) * count);
+    float* referenceX = malloc(sizeof(float) * count);
+    float* referenceY = malloc(sizeof(float) * count);
+
+    World reference;
+    WorldInit(&reference, count, 4000, 4000);
+    FillDisc(&reference, planets, handles);
+    for (int n = 0; n < blocks << (levels + 2); n++) {
+        WorldStep(&reference, dt / (1 << (levels + 2)), (Vector2) { 0, 0 }, 0);
+    }
+    for (int i = 0; i < count; i++) {
+        int id = WorldResolve(&reference, handles[i]);
+        referenceX[i] = reference.posX[id];
+        referenceY[i] = reference.posY[id];
+    }
+    WorldFree(&reference);
+
+    const char* names[] = { "uniform, dt / 16", "uniform, dt / 4", "uniform, dt", "blocks, accuracy 0.001", "blocks, accuracy 0.01", "blocks, accuracy 0.1" };
+    int splits[] = { 16, 4, 1, 1, 1, 1 };
+    float accuracies[] = { 0, 0, 0, 0.001, 0.01, 0.1 };
+    printf("| stepping | object-steps | saved | time (ms) | rms error (px) | max error (px) |\n");
+    printf("|---|---|---|---|---|---|\n");
+    for (int mode = 0; mode < 6; mode++) {
+        World world;
+        WorldInit(&world, count, 4000, 4000);
+        FillDisc(&world, planets, handles);
+        world.blockSteps = mode >= 3;
+        world.blockLevels = levels;
+        world.blockAccuracy = accuracies[mode];
+        long long uniform = (long long)count * blocks << levels;
+        double start = NowSeconds();
+        for (int n = 0; n < blocks; n++) {
+            for (int k = 0; k < splits[mode]; k++) {
+                WorldStep(&world, dt / splits[mode], (Vector2) { 0, 0 }, 0);
+            }
+        }
+        double elapsed = NowSeconds() - start;
+        long long steps = world.blockSteps ? world.objectSteps : (long long)count * blocks * splits[mode];
+        double sum = 0, max = 0;
+        for (int i = 0; i < count; i++) {
+            int id = WorldResolve(&world, handles[i]);
+            double dx = world.posX[id] - referenceX[i], dy = world.posY[id] - referenceY[i];
+            double error = sqrt(dx * dx + dy * dy);
+            sum += error * error;
+            max = fmax(max, error);
+        }
+        printf("| %s | %lld | %.0f%% | %.1f | %.3f | %.3f |\n", names[mode], steps,
+            100.0 * (uniform - steps) / uniform, elapsed * 1e3, sqrt(sum / count), max);
+        WorldFree(&world);
+    }
+    free(handles);
+    free(referenceX);
+    free(referenceY);
+}
+
+static void StepBenchWorld(SimThread* sim, float dt)
+{
+    WorldStep(sim->world, dt, (Vector2) { 0, -250 }, 0.01);
+}
+
+static void SleepUntil(double time)
+{
+    for (double now = NowSeconds(); now < time; now = NowSeconds()) {
+        struct timespec ts = { 0, (long)((time - now) * 1e9) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+// Three seconds of a 60 Hz renderer that reads every frame's snapshot and touches all of it,
+// stalling for 200 ms every 30th frame when asked to. Coupled runs the old way instead: the
+// render loop itself steps each frame's share of simulated time before drawing.
+static void RunRenderer(World* world, float speed, bool stall, bool coupled, int row, const char* name)
+{
+    const float dt = 1.0 / 120.0;
+    const double duration = 3;
+    SimThread sim;
+    SimThreadInit(&sim, world, dt, NULL);
+    sim.step = StepBenchWorld;
+    sim.speed = speed;
+    long long coupledSteps = 0;
+    double coupledStepSeconds = 0, coupledMaxStep = 0, carry = 0;
+    if (!coupled) SimThreadStart(&sim);
+
+    double start = NowSeconds(), last = start, next = start, maxFrame = 0, ageSum = 0;
+    int frames = 0;
+    float checksum = 0;
+    while (NowSeconds() - start < duration) {
+        if (coupled) {
+            for (carry += speed / 60; carry >= dt; carry -= dt) {
+                double stepStart = NowSeconds();
+                WorldStep(world, dt, (Vector2) { 0, -250 }, 0.01);
+                double elapsed = NowSeconds() - stepStart;
+                coupledSteps += 1;
+                coupledStepSeconds += elapsed;
+                coupledMaxStep = fmax(coupledMaxStep, elapsed);
+            }
+            for (int i = 0; i < world->count; i++) {
+                checksum += world->drawSizeX[i];
+            }
+        } else {
+            const Snapshot* snapshot = SimThreadRead(&sim);
+            for (int i = 0; i < snapshot->count; i++) {
+                checksum += snapshot->draw[i].size.x;
+            }
+            ageSum += sim.readerStats.age;
+        }
+        frames += 1;
+        if (stall && frames % 30 == 0) {
+            SleepUntil(NowSeconds() + 0.2);
+        }
+        // like vsync, a late frame waits for the next one instead of catching up
+        next = fmax(next + 1.0 / 60, NowSeconds());
+        SleepUntil(next);
+        double now = NowSeconds();
+        maxFrame = fmax(maxFrame, now - last);
+        last = now;
+    }
+    double elapsed = NowSeconds() - start;
+    if (!coupled) SimThreadStop(&sim);
+
+    long long steps = coupled ? coupledSteps : sim.stats.steps;
+    double stepSeconds = coupled ? coupledStepSeconds : sim.stats.stepSeconds;
+    double maxStep = coupled ? coupledMaxStep : sim.stats.maxStepSeconds;
+    printf("| %d | %s | %.0f | %.0f | %.2f / %.2f | %.2f | %.0f | %.0f | ", row, name, speed / dt, steps / elapsed,
+        1e3 * stepSeconds / steps, 1e3 * maxStep, coupled ? 0.0 : sim.stats.droppedSeconds, frames / elapsed, 1e3 * maxFrame);
+    if (coupled) {
+        printf("- | - |\n");
+    } else {
+        printf("%.1f | %.1f / %.1f |\n", 1e6 * sim.readerStats.maxReadSeconds, 1e3 * ageSum / frames, 1e3 * sim.readerStats.maxAge);
+    }
+    (void)checksum;
+    SimThreadFree(&sim);
+}
+
+static void BenchSimThread(int argc, char** argv)
+{
+    int heavy = argc > 1 ? atoi(argv[1]) : 20000;
+    printf("| run | loop | steps/s wanted | steps/s done | step ms mean / max | sim time dropped (s) | frames/s | longest frame (ms) | longest read (us) | snapshot age ms mean / max |\n");
+    printf("|---|---|---|---|---|---|---|---|---|---|\n");
+    for (int run = 0; run < 6; run++) {
+        bool stall = run % 3 == 1;
+        bool isHeavy = run % 3 == 2;
+        bool coupled = run < 3;
+        rngState = 0x2545F491u;
+        World world;
+        WorldInit(&world, heavy, 1200, 900);
+        world.collisions = true;
+        world.solver = GRAVITY_SOLVER_CUTOFF;
+        world.neighborList.cutoff = 0;
+        FillSwarm(&world, isHeavy ? heavy : 500, 2, 4);
+        const char* names[] = { "coupled", "coupled, renderer stalls", "coupled, heavy physics",
+            "threaded", "threaded, renderer stalls", "threaded, heavy physics" };
+        RunRenderer(&world, isHeavy ? 5 : 1, stall, coupled, run + 1, names[run]);
+        WorldFree(&world);
+    }
+}
+
+static void StepFreeFlight(SimThread* sim, float dt)
+{
+    WorldStep(sim->world, dt, (Vector2) { 0, 0 }, 0);
+}
+
+// Two seconds of a 60 Hz renderer, after a short warm-up, following one logo that flies at a constant 400 px/s, drawn
+// from the latest snapshot or interpolated one snapshot behind. Judder is how far each frame's
+// movement strays from what the frame's wall time calls for; lag is how far behind the
+// simulation's current time the drawn position is.
+static void BenchInterpolation(int argc, char** argv)
+{
+    const float velocity = 400;
+    const double duration = 2;
+    int rates[] = { 120, 60, 45, 30, 20 };
+    printf("| physics steps/s | drawn | judder rms / max (px) | frames that stood still | lag mean (ms) |\n");
+    printf("|---|---|---|---|---|\n");
+    for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        for (int interpolate = 0; interpolate < 2; interpolate++) {
+            World world;
+            WorldInit(&world, 4, 1e6, 1e6);
+            world.collisions = false;
+            ObjectHandle handle = WorldSpawn(&world, MakeObjectDescriptor(1e2, (Vector2) { 1000, 1000 }, (Vector2) { velocity, 0 }, (Vector2) { 8, 8 }, 1e4, 1e3));
+            SimThread sim;
+            SimThreadInit(&sim, &world, 1.0f / rates[r], NULL);
+            sim.step = StepFreeFlight;
+
+            double start = SimThreadClock();
+            SimThreadStart(&sim);
+            double next = start, lastTime = 0, lastX = 0, sumSquares = 0, maxJudder = 0, lagSum = 0;
+            int frames = 0, still = 0;
+            while (SimThreadClock() - start < duration) {
+                next = fmax(next + 1.0 / 60, SimThreadClock());
+                SleepUntil(next);
+                double now = SimThreadClock();
+                const Snapshot* snapshot = SimThreadRead(&sim);
+                // until there are two snapshots to draw between
+                if (now - start < 0.2) continue;
+                float blend = interpolate ? SnapshotBlend(snapshot, now) : 1;
+                int i = 0;
+                while (snapshot->slots[i] != handle.slot) i++;
+                double x = SnapshotDraw(snapshot, i, blend).pos.x;
+                if (frames > 0) {
+                    double judder = (x - lastX) - velocity * (now - lastTime);
+                    sumSquares += judder * judder;
+                    maxJudder = fmax(maxJudder, fabs(judder));
+                    still += x == lastX;
+                }
+                lagSum += (now - start) - (x - 1000) / velocity;
+                lastTime = now;
+                lastX = x;
+                frames += 1;
+            }
+            SimThreadStop(&sim);
+            printf("| %d | %s | %.2f / %.2f | %d of %d | %.1f |\n", rates[r], interpolate ? "interpolated" : "latest",
+                sqrt(sumSquares / (frames - 1)), maxJudder, still, frames - 1, 1e3 * lagSum / frames);
+            SimThreadFree(&sim);
+            WorldFree(&world);
+        }
+    }
+}
+
+// The window session's three logos in its default 1200x900 world.
+static void SessionLogos(ObjectDescriptor* logos)
+{
+    logos[0] = MakeObjectDescriptor(1e9, (Vector2) { 728, 450 }, (Vector2) { 0, 32 }, (Vector2) { 8, 8 }, 1e12, 1e10);
+    logos[1] = MakeObjectDescriptor(2e9, (Vector2) { 472, 450 }, (Vector2) { 0, -32 }, (Vector2) { 16, 16 }, 1e12, 1e10);
+    logos[2] = MakeObjectDescriptor(1e2, (Vector2) { 344, 450 }, (Vector2) { 0, 32 }, (Vector2) { 8, 8 }, 1e4, 1e3);
+}
+
+// Strong scaling of an ensemble of 1024 perturbed sessions, 30 simulated seconds each. The
+// summary has to come out the same for every thread count; setup is the cost of a member's world
+// alone, from a run of zero steps.
+static void BenchEnsemble(int argc, char** argv)
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : ThreadPoolDefaultThreadCount();
+    int members = argc > 2 ? atoi(argv[2]) : 1024;
+    ObjectDescriptor logos[3];
+    SessionLogos(logos);
+    Ensemble ensemble = MakeEnsemble(logos, 3, 1200, 900, 3600);
+    EnsembleMember* results = malloc(sizeof(EnsembleMember) * members);
+
+    Ensemble empty = ensemble;
+    empty.steps = 0;
+    double start = NowSeconds();
+    EnsembleRun(&empty, members, results, NULL);
+    double setup = (NowSeconds() - start) / members;
+
+    printf("%d hardware threads, %d members, %.1f us setup per member\n\n", ThreadPoolDefaultThreadCount(), members, 1e6 * setup);
+    printf("| threads | run (s) | members/s | object-steps/s | speedup | bounces mean / deviation | first bounce (s) | same summary |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    double base = 0;
+    EnsembleStats reference = {0};
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        ThreadPool pool;
+        ThreadPoolInit(&pool, threads);
+        start = NowSeconds();
+        EnsembleRun(&ensemble, members, results, &pool);
+        double elapsed = NowSeconds() - start;
+        ThreadPoolFree(&pool);
+        EnsembleStats stats = EnsembleSummarize(&ensemble, results, members);
+        if (threads == 1) {
+            base = elapsed;
+            reference = stats;
+        }
+        bool same = memcmp(&stats, &reference, sizeof(EnsembleStats)) == 0;
+        printf("| %d | %.3f | %.0f | %.3g | %.2f | %.2f / %.2f | %.2f | %s |\n", threads, elapsed, members / elapsed,
+            stats.objectSteps / elapsed, base / elapsed, stats.bounces.mean, stats.bounces.deviation, stats.firstBounce.mean, same ? "yes" : "no");
+    }
+    free(results);
+}
+
+// The same ensemble with a World per member and with WORLD_BATCH_LANES members per batch, one
+// SIMD lane each, on one thread, best of three runs. Lanes must reproduce WorldStep: the first
+// batch's positions are compared against Worlds after every step, and the per-member results as
+// a whole.
+static void BenchBatch(int argc, char** argv)
+{
+    int members = argc > 1 ? atoi(argv[1]) : 1024;
+    ObjectDescriptor logos[3];
+    SessionLogos(logos);
+    Ensemble ensemble = MakeEnsemble(logos, 3, 1200, 900, 3600);
+    EnsembleMember* perWorld = malloc(sizeof(EnsembleMember) * members);
+    EnsembleMember* batched = malloc(sizeof(EnsembleMember) * members);
+
+    World worlds[WORLD_BATCH_LANES];
+    WorldBatch batch;
+    WorldBatchInit(&batch, 3, 1200, 900);
+    for (int lane = 0; lane < WORLD_BATCH_LANES; lane++) {
+        ObjectDescriptor objects[3];
+        EnsembleMemberScene(&ensemble, lane, objects);
+        WorldBatchLoad(&batch, lane, objects);
+        WorldInit(worlds + lane, 3, 1200, 900);
+        for (int i = 0; i < 3; i++) {
+            WorldSpawn(worlds + lane, objects[i]);
+        }
+    }
+    double maxDifference = 0;
+    for (int step = 0; step < ensemble.steps; step++) {
+        WorldBatchStep(&batch, ensemble.dt, (Vector2) { 0, 0 }, ensemble.u);
+        for (int lane = 0; lane < WORLD_BATCH_LANES; lane++) {
+            WorldStep(worlds + lane, ensemble.dt, (Vector2) { 0, 0 }, ensemble.u);
+            for (int i = 0; i < 3; i++) {
+                int at = i * WORLD_BATCH_LANES + lane;
+                maxDifference = fmax(maxDifference, fabs(batch.posX[at] - worlds[lane].posX[i]));
+                maxDifference = fmax(maxDifference, fabs(batch.posY[at] - worlds[lane].posY[i]));
+            }
+        }
+    }
+    for (int lane = 0; lane < WORLD_BATCH_LANES; lane++) {
+        WorldFree(worlds + lane);
+    }
+    WorldBatchFree(&batch);
+
+    // best of three, the runs are short enough for a noisy machine to matter
+    double perWorldSeconds = INFINITY, batchedSeconds = INFINITY;
+    for (int repeat = 0; repeat < 3; repeat++) {
+        ensemble.batched = false;
+        double start = NowSeconds();
+        EnsembleRun(&ensemble, members, perWorld, NULL);
+        perWorldSeconds = fmin(perWorldSeconds, NowSeconds() - start);
+        ensemble.batched = true;
+        start = NowSeconds();
+        EnsembleRun(&ensemble, members, batched, NULL);
+        batchedSeconds = fmin(batchedSeconds, NowSeconds() - start);
+    }
+    int differing = 0;
+    for (int m = 0; m < members; m++) {
+        differing += memcmp(perWorld + m, batched + m, sizeof(EnsembleMember)) != 0;
+    }
+    EnsembleStats stats = EnsembleSummarize(&ensemble, batched, members);
+
+    printf("%s, %d lanes per vector, %d worlds per batch, %d members of %d steps, one thread\n\n", SimdName(), SimdWidth(), WORLD_BATCH_LANES, members, ensemble.steps);
+    printf("| stepper | run (s) | members/s | object-steps/s | speedup |\n");
+    printf("|---|---|---|---|---|\n");
+    printf("| world per member | %.3f | %.0f | %.3g | 1.00 |\n", perWorldSeconds, members / perWorldSeconds, stats.objectSteps / perWorldSeconds);
+    printf("| batched | %.3f | %.0f | %.3g | %.2f |\n\n", batchedSeconds, members / batchedSeconds, stats.objectSteps / batchedSeconds, perWorldSeconds / batchedSeconds);
+    printf("largest position difference to WorldStep over %d steps of %d worlds: %g px\n", ensemble.steps, WORLD_BATCH_LANES, maxDifference);
+    printf("members whose bounce record differs: %d of %d\n", differing, members);
+    free(perWorld);
+    free(batched);
+}
+
+// Dense sampling of the overlap function in doubles, for checking the narrowphase.
+static double EllipseDepthReference(float ax, float ay, float aSizeX, float aSizeY, float bx, float by, float bSizeX, float bSizeY)
+{
+    double best = INFINITY;
+    for (int k = 0; k < 20000; k++) {
+        double c = cos(k * 2 * PI / 20000), s = sin(k * 2 * PI / 20000);
+        double f = sqrt((double)aSizeX * aSizeX * c * c + (double)aSizeY * aSizeY * s * s)
+            + sqrt((double)bSizeX * bSizeX * c * c + (double)bSizeY * bSizeY * s * s) - ((bx - ax) * c + (by - ay) * s);
+        best = fmin(best, f);
+    }
+    return best;
+}
+
+// Ellipse narrowphase: ns per pair through the batched call over a broadphase pair list, and the
+// depth against dense sampling for squished shapes, next to the line-of-centres estimate it
+// replaced in object contact.
+static void BenchNarrowphase(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    int count = 100000;
+    World world;
+    WorldInit(&world, count, 12000, 12000);
+    rngState = 0x2545F491u;
+    // squished like MakeObjectDrawDescriptor does it: area kept, up to half off one axis
+    for (int i = 0; i < count; i++) {
+        float size = RandomFloat(8, 24);
+        float squish = RandomFloat(0.5f, 1);
+        Vector2 s = RandomFloat(0, 1) < 0.5f ? (Vector2) { size * squish, size / squish } : (Vector2) { size / squish, size * squish };
+        Vector2 pos = { RandomFloat(0, world.width), RandomFloat(0, world.height) };
+        WorldSpawn(&world, MakeObjectDescriptor(1, pos, (Vector2) { 0, 0 }, s, 1, 0));
+    }
+    world.reorderInterval = 0;
+    WorldFindPairs(&world);
+    int pairs = CountPairs(&world);
+    BodyPair* list = malloc(sizeof(BodyPair) * pairs);
+    EllipseContact* contacts = malloc(sizeof(EllipseContact) * pairs);
+    for (int w = 0, n = 0; w < world.pairListCount; w++) {
+        memcpy(list + n, world.pairLists[w].pairs, sizeof(BodyPair) * world.pairLists[w].count);
+        n += world.pairLists[w].count;
+    }
+
+    int repeats = 20;
+    double start = NowSeconds();
+    for (int r = 0; r < repeats; r++) {
+        EllipseContacts(world.posX, world.posY, world.sizeX, world.sizeY, list, pairs, contacts);
+    }
+    double perPair = (NowSeconds() - start) / repeats / pairs;
+
+    int overlapping = 0, checked = 0;
+    double maxError = 0, maxCentreError = 0, maxPointError = 0;
+    for (int p = 0; p < pairs; p++) {
+        int a = list[p].a, b = list[p].b;
+        EllipseContact contact = contacts[p];
+        overlapping += contact.depth > 0;
+        if (p % 16) continue;
+        checked += 1;
+        double scale = fmin(fmin(world.sizeX[a], world.sizeY[a]), fmin(world.sizeX[b], world.sizeY[b]));
+        double reference = EllipseDepthReference(world.posX[a], world.posY[a], world.sizeX[a], world.sizeY[a], world.posX[b], world.posY[b], world.sizeX[b], world.sizeY[b]);
+        // apart, the depth is only some negative value
+        if (reference > 0) maxError = fmax(maxError, fabs(contact.depth - reference) / scale);
+        // old estimate: radii along the line of centres
+        double dx = world.posX[b] - world.posX[a], dy = world.posY[b] - world.posY[a];
+        double d = hypot(dx, dy), nx = dx / d, ny = dy / d;
+        double ra = world.sizeX[a] * world.sizeY[a] / hypot(world.sizeY[a] * nx, world.sizeX[a] * ny);
+        double rb = world.sizeX[b] * world.sizeY[b] / hypot(world.sizeY[b] * nx, world.sizeX[b] * ny);
+        if (reference > 0) maxCentreError = fmax(maxCentreError, fabs(ra + rb - d - reference) / scale);
+        // moving b back along the normal by the depth should leave them just touching
+        if (contact.depth > 0) {
+            EllipseContact apart = EllipseEllipseContact(world.posX[a], world.posY[a], world.sizeX[a], world.sizeY[a],
+                world.posX[b] + contact.normalX * contact.depth, world.posY[b] + contact.normalY * contact.depth, world.sizeX[b], world.sizeY[b]);
+            maxPointError = fmax(maxPointError, fabs(apart.depth) / scale);
+        }
+    }
+
+    printf("| pairs | overlapping | ns / pair | checked | max depth error / size | line-of-centres error / size | residual after separating / size |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    printf("| %d | %d | %.1f | %d | %.2e | %.2e | %.2e |\n", pairs, overlapping, perPair * 1e9, checked, maxError, maxCentreError, maxPointError);
+    free(list);
+    free(contacts);
+    WorldFree(&world);
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(int argc, char** argv);
+} Bench;
+
+static const Bench benches[] = {
+    { "barneshut", BenchBarnesHut },
+    { "fmm", BenchFmm },
+    { "p3m", BenchParticleMesh },
+    { "simd", BenchSimd },
+    { "threads", BenchThreads },
+    { "steal", BenchSteal },
+    { "spawn", BenchSpawn },
+    { "pairs", BenchPairs },
+    { "neighbors", BenchNeighbors },
+    { "grid", BenchGrid },
+    { "tree", BenchTree },
+    { "pile", BenchPile },
+    { "narrowphase", BenchNarrowphase },
+    { "sleep", BenchSleep },
+    { "ccd", BenchCcd },
+    { "adaptive", BenchAdaptive },
+    { "substeps", BenchSubsteps },
+    { "integrators", BenchIntegrators },
+    { "blocks", BenchBlocks },
+    { "simthread", BenchSimThread },
+    { "interpolation", BenchInterpolation },
+    { "ensemble", BenchEnsemble },
+    { "batch", BenchBatch },
+};
+
+int main(int argc, char** argv)
+{
+    int benchCount = sizeof(benches) / sizeof(benches[0]);
+    for (int i = 0; i < benchCount; i++) {
+        if (argc < 2 || strcmp(argv[1], benches[i].name) == 0) {
+            printf("## %s\n\n", benches[i].name);
+            benches[i].run(argc - 1, argv + 1);
+            printf("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "stdlib.h"
+
+typedef enum {
+    BROADPHASE_GRID = 0, // spatialhash.h, for bodies of similar size
+    BROADPHASE_TREE, // aabbtree.h, for mixed sizes
+    BROADPHASE_COUNT
+} Broadphase;
+
+// Candidate pair from a broadphase: the bounding boxes of bodies a and b overlap, a < b.
+typedef struct {
+    int a;
+    int b;
+} BodyPair;
+
+// Growable pair buffer, reused across substeps so it stops allocating once it is big enough.
+typedef struct {
+    BodyPair* pairs;
+    int count;
+    int capacity;
+} PairList;
+
+// Makes room for extra more pairs.
+static inline void PairListReserve(PairList* list, int extra)
+{
+    if (list->count + extra > list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 1024;
+        if (list->capacity < list->count + extra) list->capacity = list->count + extra;
+        list->pairs = realloc(list->pairs, sizeof(BodyPair) * list->capacity);
+    }
+}
+
+static inline void PairListPush(PairList* list, int a, int b)
+{
+    PairListReserve(list, 1);
+    BodyPair pair = { a < b ? a : b, a < b ? b : a };
+    list->pairs[list->count++] = pair;
+}
+
+static inline void PairListFree(PairList* list)
+{
+    free(list->pairs);
+    list->pairs = NULL;
+    list->count = list->capacity = 0;
+}
+
+#endif
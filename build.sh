@@ -1,3 +1,6 @@
 #!/usr/bin/env zsh
 
-gcc main.c -Iraylib-5.0_macos/include -Lraylib-5.0_macos/lib -lraylib -framework CoreVideo -framework IOKit -framework Cocoa -framework GLUT -framework OpenGL
+physics=(world.c simd.c threadpool.c barneshut.c fmm.c particlemesh.c neighborlist.c spatialhash.c aabbtree.c narrowphase.c simthread.c ensemble.c batch.c)
+
+gcc -O2 main.c $physics -Iraylib-5.0_macos/include -Lraylib-5.0_macos/lib -lraylib -framework CoreVideo -framework IOKit -framework Cocoa -framework GLUT -framework OpenGL
+gcc -O2 bench.c $physics -Iraylib-5.0_macos/include -o bench
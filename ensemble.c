@@ -0,0 +1,206 @@
+#include "ensemble.h"
+
+#include "math.h"
+#include "string.h"
+
+Ensemble MakeEnsemble(const ObjectDescriptor* scene, int objectCount, float width, float height, int steps)
+{
+    Ensemble ensemble = {0};
+    ensemble.scene = scene;
+    ensemble.objectCount = objectCount < ENSEMBLE_OBJECTS_MAX ? objectCount : ENSEMBLE_OBJECTS_MAX;
+    ensemble.width = width;
+    ensemble.height = height;
+    ensemble.dt = 1.0 / 120.0;
+    ensemble.u = 0.01;
+    ensemble.steps = steps;
+    ensemble.positionJitter = 16;
+    ensemble.speedJitter = 8;
+    ensemble.massJitter = 0.1;
+    ensemble.stiffnessJitter = 0.1;
+    ensemble.energyLossJitter = 0.1;
+    ensemble.seed = 1;
+    return ensemble;
+}
+
+// Uniform in [-1, 1) from a splitmix32 stream.
+static float Jitter(unsigned int* state)
+{
+    unsigned int z = (*state += 0x9E3779B9u);
+    z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+    z ^= z >> 16;
+    return (z >> 8) * (2.0f / 16777216.0f) - 1;
+}
+
+void EnsembleMemberScene(const Ensemble* ensemble, int member, ObjectDescriptor* objects)
+{
+    // far apart streams for neighbouring members and seeds
+    unsigned int state = ensemble->seed * 0x9E3779B9u ^ (unsigned int)member * 0x632BE5ABu;
+    for (int i = 0; i < ensemble->objectCount; i++) {
+        ObjectDescriptor object = ensemble->scene[i];
+        object.pos.x += ensemble->positionJitter * Jitter(&state);
+        object.pos.y += ensemble->positionJitter * Jitter(&state);
+        object.speed.x += ensemble->speedJitter * Jitter(&state);
+        object.speed.y += ensemble->speedJitter * Jitter(&state);
+        object.mass *= 1 + ensemble->massJitter * Jitter(&state);
+        object.stiffness *= 1 + ensemble->stiffnessJitter * Jitter(&state);
+        object.energyLoss *= 1 + ensemble->energyLossJitter * Jitter(&state);
+        objects[i] = object;
+    }
+}
+
+// Object id of a member just finished a step with these wall contact counters.
+static void RecordBounces(const Ensemble* ensemble, EnsembleMember* result, int step, int id, int bounceX, int bounceY, float speedX, float speedY)
+{
+    bool startedX = bounceX == 1;
+    bool startedY = bounceY == 1;
+    if (!startedX && !startedY)
+        return;
+    result->bounces[id] += startedX + startedY;
+    result->impactSpeedSum += startedX * fabsf(speedX) + startedY * fabsf(speedY);
+    if (result->firstBounce < 0)
+        result->firstBounce = (step + 1) * ensemble->dt;
+}
+
+static void RunMember(const Ensemble* ensemble, int member, EnsembleMember* result)
+{
+    ObjectDescriptor objects[ENSEMBLE_OBJECTS_MAX];
+    EnsembleMemberScene(ensemble, member, objects);
+    // a world of its own on no pool: the ensemble's parallelism is across members
+    World world;
+    WorldInit(&world, ensemble->objectCount, ensemble->width, ensemble->height);
+    for (int i = 0; i < ensemble->objectCount; i++) {
+        WorldSpawn(&world, objects[i]);
+    }
+
+    memset(result, 0, sizeof(EnsembleMember));
+    result->firstBounce = -1;
+    for (int step = 0; step < ensemble->steps; step++) {
+        WorldStep(&world, ensemble->dt, (Vector2) { 0, 0 }, ensemble->u);
+        for (int id = 0; id < world.count; id++) {
+            // slots were handed out in spawn order, so they are the scene's indices
+            RecordBounces(ensemble, result, step, world.objectSlot[id], world.bounceX[id], world.bounceY[id], world.speedX[id], world.speedY[id]);
+        }
+    }
+    WorldFree(&world);
+}
+
+// Members [first, first + count), count at most WORLD_BATCH_LANES, in the lanes of one batch.
+// Spare lanes repeat the last member and are not recorded.
+static void RunBatch(const Ensemble* ensemble, int first, int count, EnsembleMember* results)
+{
+    WorldBatch batch;
+    WorldBatchInit(&batch, ensemble->objectCount, ensemble->width, ensemble->height);
+    for (int lane = 0; lane < WORLD_BATCH_LANES; lane++) {
+        ObjectDescriptor objects[ENSEMBLE_OBJECTS_MAX];
+        EnsembleMemberScene(ensemble, first + (lane < count ? lane : count - 1), objects);
+        WorldBatchLoad(&batch, lane, objects);
+    }
+
+    for (int lane = 0; lane < count; lane++) {
+        memset(results + first + lane, 0, sizeof(EnsembleMember));
+        results[first + lane].firstBounce = -1;
+    }
+    for (int step = 0; step < ensemble->steps; step++) {
+        WorldBatchStep(&batch, ensemble->dt, (Vector2) { 0, 0 }, ensemble->u);
+        for (int id = 0; id < batch.count; id++) {
+            for (int lane = 0; lane < count; lane++) {
+                int i = id * WORLD_BATCH_LANES + lane;
+                RecordBounces(ensemble, results + first + lane, step, id, batch.bounceX[i], batch.bounceY[i], batch.speedX[i], batch.speedY[i]);
+            }
+        }
+    }
+    WorldBatchFree(&batch);
+}
+
+typedef struct {
+    const Ensemble* ensemble;
+    EnsembleMember* results;
+    int count;
+} EnsembleTaskContext;
+
+static void EnsembleTask(void* context, int begin, int end, int worker)
+{
+    EnsembleTaskContext* task = context;
+    for (int member = begin; member < end; member++) {
+        RunMember(task->ensemble, member, task->results + member);
+    }
+}
+
+static void EnsembleBatchTask(void* context, int begin, int end, int worker)
+{
+    EnsembleTaskContext* task = context;
+    for (int b = begin; b < end; b++) {
+        int first = b * WORLD_BATCH_LANES;
+        int count = task->count - first < WORLD_BATCH_LANES ? task->count - first : WORLD_BATCH_LANES;
+        RunBatch(task->ensemble, first, count, task->results);
+    }
+}
+
+void EnsembleRun(const Ensemble* ensemble, int count, EnsembleMember* results, ThreadPool* pool)
+{
+    EnsembleTaskContext context = { ensemble, results, count };
+    if (ensemble->batched) {
+        ThreadPoolParallelFor(pool, (count + WORLD_BATCH_LANES - 1) / WORLD_BATCH_LANES, EnsembleBatchTask, &context);
+    } else {
+        ThreadPoolParallelFor(pool, count, EnsembleTask, &context);
+    }
+}
+
+typedef struct {
+    int count;
+    double sum;
+    double sumSquares;
+    double min;
+    double max;
+} Accumulator;
+
+static void Accumulate(Accumulator* a, double value)
+{
+    a->min = a->count ? fmin(a->min, value) : value;
+    a->max = a->count ? fmax(a->max, value) : value;
+    a->count += 1;
+    a->sum += value;
+    a->sumSquares += value * value;
+}
+
+static EnsembleSummary Summarize(const Accumulator* a)
+{
+    if (a->count == 0)
+        return (EnsembleSummary) {0};
+    double mean = a->sum / a->count;
+    double variance = a->sumSquares / a->count - mean * mean;
+    return (EnsembleSummary) { mean, sqrt(variance > 0 ? variance : 0), a->min, a->max };
+}
+
+// Serial and in member order, so the numbers are the same for any thread count.
+EnsembleStats EnsembleSummarize(const Ensemble* ensemble, const EnsembleMember* results, int count)
+{
+    Accumulator bounces = {0}, firstBounce = {0};
+    Accumulator objectBounces[ENSEMBLE_OBJECTS_MAX] = {0};
+    double impactSpeedSum = 0;
+    EnsembleStats stats = {0};
+    stats.members = count;
+    for (int member = 0; member < count; member++) {
+        const EnsembleMember* result = results + member;
+        int total = 0;
+        for (int i = 0; i < ensemble->objectCount; i++) {
+            Accumulate(objectBounces + i, result->bounces[i]);
+            total += result->bounces[i];
+        }
+        Accumulate(&bounces, total);
+        impactSpeedSum += result->impactSpeedSum;
+        if (result->firstBounce < 0)
+            stats.neverBounced += 1;
+        else
+            Accumulate(&firstBounce, result->firstBounce);
+    }
+    stats.bounces = Summarize(&bounces);
+    for (int i = 0; i < ensemble->objectCount; i++) {
+        stats.objectBounces[i] = Summarize(objectBounces + i);
+    }
+    stats.firstBounce = Summarize(&firstBounce);
+    stats.meanImpactSpeed = bounces.sum > 0 ? impactSpeedSum / bounces.sum : 0;
+    stats.objectSteps = (long long)count * ensemble->steps * ensemble->objectCount;
+    return stats;
+}
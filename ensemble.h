@@ -0,0 +1,62 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "batch.h"
+#include "world.h"
+
+#define ENSEMBLE_OBJECTS_MAX 16
+
+// Many independent copies of one small scene, each with its initial conditions perturbed by its
+// own random stream, stepped across the thread pool. One pool job runs whole members, so nothing
+// is shared between them and the results do not depend on the thread count.
+typedef struct {
+    const ObjectDescriptor* scene;
+    int objectCount; // at most ENSEMBLE_OBJECTS_MAX
+    float width;
+    float height;
+    float dt;
+    float u;
+    int steps;
+    // uniform perturbations, absolute for positions and speeds and relative for the rest
+    float positionJitter;
+    float speedJitter;
+    float massJitter;
+    float stiffnessJitter;
+    float energyLossJitter;
+    unsigned int seed; // member i draws from a stream of its own, derived from seed and i
+    bool batched; // WORLD_BATCH_LANES members per job, a SIMD lane each, instead of a World each
+} Ensemble;
+
+// What one member did: wall bounces begun per object, when the first of them came and how fast
+// objects hit the walls.
+typedef struct {
+    int bounces[ENSEMBLE_OBJECTS_MAX];
+    float firstBounce; // simulated seconds, -1 when nothing bounced
+    float impactSpeedSum;
+} EnsembleMember;
+
+typedef struct {
+    double mean;
+    double deviation;
+    double min;
+    double max;
+} EnsembleSummary;
+
+typedef struct {
+    int members;
+    EnsembleSummary bounces; // per member, all objects
+    EnsembleSummary objectBounces[ENSEMBLE_OBJECTS_MAX];
+    EnsembleSummary firstBounce; // over members that bounced
+    int neverBounced;
+    double meanImpactSpeed;
+    long long objectSteps;
+} EnsembleStats;
+
+Ensemble MakeEnsemble(const ObjectDescriptor* scene, int objectCount, float width, float height, int steps);
+// The initial conditions of member.
+void EnsembleMemberScene(const Ensemble* ensemble, int member, ObjectDescriptor* objects);
+// Runs members [0, count) across pool (NULL runs them here) into results.
+void EnsembleRun(const Ensemble* ensemble, int count, EnsembleMember* results, ThreadPool* pool);
+EnsembleStats EnsembleSummarize(const Ensemble* ensemble, const EnsembleMember* results, int count);
+
+#endif
@@ -0,0 +1,426 @@
+#include "fmm.h"
+
+#include "math.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define FMM_MAX_LEVELS 10
+#define FMM_KERNEL_ORDER (2 * FMM_MAX_ORDER)
+#define FMM_KERNEL_STRIDE (FMM_KERNEL_ORDER + 1)
+#define FMM_OFFSETS 49 // relative cell offsets -3..3 in x and y
+
+static int TermIndex(int a, int b)
+{
+    int t = a + b;
+    return t * (t + 1) / 2 + b;
+}
+
+static int LevelOffset(int level)
+{
+    return ((1 << (2 * level)) - 1) / 3;
+}
+
+static int OffsetIndex(int ox, int oy)
+{
+    return (ox + 3) * 7 + (oy + 3);
+}
+
+// out[a] = v^a / a!
+static void ScaledPowers(double v, int n, double* out)
+{
+    out[0] = 1;
+    for (int a = 1; a <= n; a++) {
+        out[a] = out[a - 1] * v / a;
+    }
+}
+
+// All partial derivatives d^(i+j)/dx^i dy^j of 1/r at (x, y) up to total order maxOrder,
+// from the recurrence R(k)[n+1][m] = x R(k+1)[n][m] + n R(k+1)[n-1][m] with
+// R(k)[0][0] = (-1)^k (2k-1)!! / r^(2k+1).
+static void Derivatives(double x, double y, int maxOrder, double* out)
+{
+    double prev[FMM_KERNEL_STRIDE][FMM_KERNEL_STRIDE];
+    double cur[FMM_KERNEL_STRIDE][FMM_KERNEL_STRIDE];
+    double invR2 = 1.0 / (x * x + y * y);
+    double base[FMM_KERNEL_STRIDE];
+    base[0] = sqrt(invR2);
+    for (int k = 1; k <= maxOrder; k++) {
+        base[k] = -base[k - 1] * (2 * k - 1) * invR2;
+    }
+
+    for (int k = maxOrder; k >= 0; k--) {
+        for (int t = 0; t <= maxOrder - k; t++) {
+            for (int n = 0; n <= t; n++) {
+                int m = t - n;
+                if (t == 0) {
+                    cur[0][0] = base[k];
+                } else if (n > 0) {
+                    cur[n][m] = x * prev[n - 1][m] + (n > 1 ? (n - 1) * prev[n - 2][m] : 0);
+                } else {
+                    cur[0][m] = y * prev[0][m - 1] + (m > 1 ? (m - 1) * prev[0][m - 2] : 0);
+                }
+            }
+        }
+        memcpy(prev, cur, sizeof(cur));
+    }
+
+    for (int i = 0; i <= maxOrder; i++) {
+        for (int j = 0; i + j <= maxOrder; j++) {
+            out[i * FMM_KERNEL_STRIDE + j] = prev[i][j];
+        }
+    }
+}
+
+void FmmInit(Fmm* fmm, int order)
+{
+    memset(fmm, 0, sizeof(*fmm));
+    if (order < 1) order = 1;
+    if (order > FMM_MAX_ORDER) order = FMM_MAX_ORDER;
+    fmm->order = order;
+    fmm->leafSize = 16;
+    fmm->termCount = (order + 1) * (order + 2) / 2;
+}
+
+// Kernels for unit cell width, rescaled per level since d^n(1/r) is homogeneous of degree -(n+1).
+// Built on first use: they take longer than the rest of a small world's setup, and most worlds
+// never pick this solver.
+static void BuildKernels(Fmm* fmm)
+{
+    fmm->derivatives = calloc(FMM_OFFSETS * FMM_KERNEL_STRIDE * FMM_KERNEL_STRIDE, sizeof(double));
+    fmm->levelDerivatives = calloc(FMM_OFFSETS * FMM_KERNEL_STRIDE * FMM_KERNEL_STRIDE, sizeof(double));
+    for (int ox = -3; ox <= 3; ox++) {
+        for (int oy = -3; oy <= 3; oy++) {
+            if (abs(ox) <= 1 && abs(oy) <= 1) continue;
+            Derivatives(ox, oy, 2 * fmm->order, fmm->derivatives + OffsetIndex(ox, oy) * FMM_KERNEL_STRIDE * FMM_KERNEL_STRIDE);
+        }
+    }
+}
+
+void FmmFree(Fmm* fmm)
+{
+    free(fmm->multipoles);
+    free(fmm->locals);
+    free(fmm->derivatives);
+    free(fmm->levelDerivatives);
+    free(fmm->leafStart);
+    free(fmm->bodies);
+    free(fmm->sortedX);
+    free(fmm->sortedY);
+    free(fmm->sortedMass);
+    memset(fmm, 0, sizeof(*fmm));
+}
+
+static void Reserve(Fmm* fmm, int count, int levels)
+{
+    int cells = LevelOffset(levels + 1);
+    if (cells > fmm->cellCapacity) {
+        fmm->multipoles = realloc(fmm->multipoles, sizeof(double) * cells * fmm->termCount);
+        fmm->locals = realloc(fmm->locals, sizeof(double) * cells * fmm->termCount);
+        fmm->cellCapacity = cells;
+    }
+    int leaves = 1 << (2 * levels);
+    if (leaves + 1 > fmm->leafCapacity) {
+        fmm->leafStart = realloc(fmm->leafStart, sizeof(int) * (leaves + 1));
+        fmm->leafCapacity = leaves + 1;
+    }
+    if (count > fmm->bodyCapacity) {
+        fmm->bodies = realloc(fmm->bodies, sizeof(int) * count);
+        fmm->sortedX = realloc(fmm->sortedX, sizeof(float) * count);
+        fmm->sortedY = realloc(fmm->sortedY, sizeof(float) * count);
+        fmm->sortedMass = realloc(fmm->sortedMass, sizeof(float) * count);
+        fmm->bodyCapacity = count;
+    }
+}
+
+static void SortIntoLeaves(Fmm* fmm, const float* x, const float* y, const float* mass, int count)
+{
+    int side = 1 << fmm->levels;
+    int leaves = side * side;
+    float invLeafWidth = side / fmm->width;
+    int* start = fmm->leafStart;
+
+    memset(start, 0, sizeof(int) * (leaves + 1));
+    for (int i = 0; i < count; i++) {
+        int ix = (int)((x[i] - fmm->minX) * invLeafWidth);
+        int iy = (int)((y[i] - fmm->minY) * invLeafWidth);
+        ix = ix < 0 ? 0 : ix >= side ? side - 1 : ix;
+        iy = iy < 0 ? 0 : iy >= side ? side - 1 : iy;
+        start[iy * side + ix + 1] += 1;
+    }
+    for (int c = 0; c < leaves; c++) {
+        start[c + 1] += start[c];
+    }
+    // second pass scatters using start[] as cursors, then shifts them back
+    for (int i = 0; i < count; i++) {
+        int ix = (int)((x[i] - fmm->minX) * invLeafWidth);
+        int iy = (int)((y[i] - fmm->minY) * invLeafWidth);
+        ix = ix < 0 ? 0 : ix >= side ? side - 1 : ix;
+        iy = iy < 0 ? 0 : iy >= side ? side - 1 : iy;
+        int slot = start[iy * side + ix]++;
+        fmm->bodies[slot] = i;
+        fmm->sortedX[slot] = x[i];
+        fmm->sortedY[slot] = y[i];
+        fmm->sortedMass[slot] = mass[i];
+    }
+    for (int c = leaves; c > 0; c--) {
+        start[c] = start[c - 1];
+    }
+    start[0] = 0;
+}
+
+static void ParticleToMultipole(Fmm* fmm)
+{
+    int p = fmm->order;
+    int side = 1 << fmm->levels;
+    double leafWidth = (double)fmm->width / side;
+    double px[FMM_MAX_ORDER + 1], py[FMM_MAX_ORDER + 1];
+
+    for (int iy = 0; iy < side; iy++) {
+        for (int ix = 0; ix < side; ix++) {
+            int leaf = iy * side + ix;
+            double* M = fmm->multipoles + (LevelOffset(fmm->levels) + leaf) * fmm->termCount;
+            double cx = fmm->minX + (ix + 0.5) * leafWidth;
+            double cy = fmm->minY + (iy + 0.5) * leafWidth;
+            for (int k = fmm->leafStart[leaf]; k < fmm->leafStart[leaf + 1]; k++) {
+                ScaledPowers(fmm->sortedX[k] - cx, p, px);
+                ScaledPowers(fmm->sortedY[k] - cy, p, py);
+                double m = fmm->sortedMass[k];
+                for (int a = 0; a <= p; a++) {
+                    for (int b = 0; a + b <= p; b++) {
+                        M[TermIndex(a, b)] += m * px[a] * py[b];
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void MultipoleToMultipole(Fmm* fmm, int level)
+{
+    int p = fmm->order;
+    int side = 1 << level;
+    double childWidth = fmm->width / (2 * side);
+    double tx[FMM_MAX_ORDER + 1], ty[FMM_MAX_ORDER + 1];
+
+    for (int q = 0; q < 4; q++) {
+        // every child in quadrant q sits at the same offset from its parent center
+        ScaledPowers((q & 1 ? 0.5 : -0.5) * childWidth, p, tx);
+        ScaledPowers((q & 2 ? 0.5 : -0.5) * childWidth, p, ty);
+        for (int iy = 0; iy < side; iy++) {
+            for (int ix = 0; ix < side; ix++) {
+                int child = (2 * iy + (q >> 1)) * (2 * side) + 2 * ix + (q & 1);
+                const double* C = fmm->multipoles + (LevelOffset(level + 1) + child) * fmm->termCount;
+                if (C[0] == 0) continue;
+                double* M = fmm->multipoles + (LevelOffset(level) + iy * side + ix) * fmm->termCount;
+                for (int a = 0; a <= p; a++) {
+                    for (int b = 0; a + b <= p; b++) {
+                        double sum = 0;
+                        for (int i = 0; i <= a; i++) {
+                            for (int j = 0; j <= b; j++) {
+                                sum += C[TermIndex(i, j)] * tx[a - i] * ty[b - j];
+                            }
+                        }
+                        M[TermIndex(a, b)] += sum;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void MultipoleToLocal(Fmm* fmm, int level)
+{
+    double* kernels = fmm->levelDerivatives;
+    int p = fmm->order;
+    int side = 1 << level;
+    double cellWidth = fmm->width / side;
+    const int kernelSize = FMM_KERNEL_STRIDE * FMM_KERNEL_STRIDE;
+
+    double scale[FMM_KERNEL_STRIDE];
+    scale[0] = 1.0 / cellWidth;
+    for (int n = 1; n <= 2 * p; n++) {
+        scale[n] = scale[n - 1] / cellWidth;
+    }
+    for (int o = 0; o < FMM_OFFSETS; o++) {
+        const double* unit = fmm->derivatives + o * kernelSize;
+        for (int i = 0; i <= 2 * p; i++) {
+            for (int j = 0; i + j <= 2 * p; j++) {
+                kernels[o * kernelSize + i * FMM_KERNEL_STRIDE + j] = unit[i * FMM_KERNEL_STRIDE + j] * scale[i + j];
+            }
+        }
+    }
+
+    for (int iy = 0; iy < side; iy++) {
+        for (int ix = 0; ix < side; ix++) {
+            int target = LevelOffset(level) + iy * side + ix;
+            if (fmm->multipoles[target * fmm->termCount] == 0) continue;
+            double* L = fmm->locals + target * fmm->termCount;
+
+            // interaction list: children of the parent's neighbours that are not our own neighbours
+            int px = ix >> 1, py = iy >> 1;
+            for (int sy = 2 * (py - 1); sy < 2 * (py + 2); sy++) {
+                for (int sx = 2 * (px - 1); sx < 2 * (px + 2); sx++) {
+                    if (sx < 0 || sy < 0 || sx >= side || sy >= side) continue;
+                    if (abs(sx - ix) <= 1 && abs(sy - iy) <= 1) continue;
+                    const double* M = fmm->multipoles + (LevelOffset(level) + sy * side + sx) * fmm->termCount;
+                    if (M[0] == 0) continue;
+                    const double* D = kernels + OffsetIndex(ix - sx, iy - sy) * kernelSize;
+                    for (int n = 0; n <= p; n++) {
+                        for (int m = 0; n + m <= p; m++) {
+                            double sum = 0;
+                            for (int a = 0; a <= p - n - m; a++) {
+                                for (int b = 0; a + b + n + m <= p; b++) {
+                                    sum += M[TermIndex(a, b)] * D[(a + n) * FMM_KERNEL_STRIDE + b + m];
+                                }
+                            }
+                            L[TermIndex(n, m)] += sum;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void LocalToLocal(Fmm* fmm, int level)
+{
+    int p = fmm->order;
+    int side = 1 << level;
+    double childWidth = fmm->width / (2 * side);
+    double sx[FMM_MAX_ORDER + 1], sy[FMM_MAX_ORDER + 1];
+
+    for (int q = 0; q < 4; q++) {
+        ScaledPowers((q & 1 ? 0.5 : -0.5) * childWidth, p, sx);
+        ScaledPowers((q & 2 ? 0.5 : -0.5) * childWidth, p, sy);
+        for (int iy = 0; iy < side; iy++) {
+            for (int ix = 0; ix < side; ix++) {
+                const double* L = fmm->locals + (LevelOffset(level) + iy * side + ix) * fmm->termCount;
+                int child = LevelOffset(level + 1) + (2 * iy + (q >> 1)) * (2 * side) + 2 * ix + (q & 1);
+                if (fmm->multipoles[child * fmm->termCount] == 0) continue;
+                double* C = fmm->locals + child * fmm->termCount;
+                for (int n = 0; n <= p; n++) {
+                    for (int m = 0; n + m <= p; m++) {
+                        double sum = 0;
+                        for (int i = n; i <= p; i++) {
+                            for (int j = m; i + j <= p; j++) {
+                                sum += L[TermIndex(i, j)] * sx[i - n] * sy[j - m];
+                            }
+                        }
+                        C[TermIndex(n, m)] += sum;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void Evaluate(Fmm* fmm, float* fx, float* fy)
+{
+    const double G = GRAVITY_CONSTANT;
+    int p = fmm->order;
+    int side = 1 << fmm->levels;
+    double leafWidth = (double)fmm->width / side;
+    double dx[FMM_MAX_ORDER + 1], dy[FMM_MAX_ORDER + 1];
+
+    for (int iy = 0; iy < side; iy++) {
+        for (int ix = 0; ix < side; ix++) {
+            int leaf = iy * side + ix;
+            const double* L = fmm->locals + (LevelOffset(fmm->levels) + leaf) * fmm->termCount;
+            double cx = fmm->minX + (ix + 0.5) * leafWidth;
+            double cy = fmm->minY + (iy + 0.5) * leafWidth;
+
+            for (int k = fmm->leafStart[leaf]; k < fmm->leafStart[leaf + 1]; k++) {
+                float bx = fmm->sortedX[k];
+                float by = fmm->sortedY[k];
+
+                // far field: gradient of the local expansion
+                ScaledPowers(bx - cx, p, dx);
+                ScaledPowers(by - cy, p, dy);
+                double gx = 0, gy = 0;
+                for (int n = 0; n <= p; n++) {
+                    for (int m = 0; n + m <= p; m++) {
+                        double l = L[TermIndex(n, m)];
+                        if (n > 0) gx += l * dx[n - 1] * dy[m];
+                        if (m > 0) gy += l * dx[n] * dy[m - 1];
+                    }
+                }
+
+                // near field: direct sum over the 3x3 neighbouring leaves
+                float ax = 0, ay = 0;
+                for (int ny = iy - 1; ny <= iy + 1; ny++) {
+                    for (int nx = ix - 1; nx <= ix + 1; nx++) {
+                        if (nx < 0 || ny < 0 || nx >= side || ny >= side) continue;
+                        int neighbour = ny * side + nx;
+                        for (int j = fmm->leafStart[neighbour]; j < fmm->leafStart[neighbour + 1]; j++) {
+                            if (j == k) continue;
+                            float rx = fmm->sortedX[j] - bx;
+                            float ry = fmm->sortedY[j] - by;
+                            float r2 = rx * rx + ry * ry;
+                            float s = fmm->sortedMass[j] / (r2 * sqrtf(r2));
+                            ax += rx * s;
+                            ay += ry * s;
+                        }
+                    }
+                }
+
+                int body = fmm->bodies[k];
+                double m = fmm->sortedMass[k];
+                fx[body] = G * m * (gx + ax);
+                fy[body] = G * m * (gy + ay);
+            }
+        }
+    }
+}
+
+void FmmForces(Fmm* fmm, const float* x, const float* y, const float* mass, int count, float* fx, float* fy)
+{
+    int levels = 2;
+    while (levels < FMM_MAX_LEVELS && (1 << (2 * levels)) * fmm->leafSize < count) {
+        levels++;
+    }
+    fmm->levels = levels;
+    if (count == 0) return;
+    if (!fmm->derivatives) BuildKernels(fmm);
+    Reserve(fmm, count, levels);
+
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    for (int i = 0; i < count; i++) {
+        minX = fminf(minX, x[i]);
+        minY = fminf(minY, y[i]);
+        maxX = fmaxf(maxX, x[i]);
+        maxY = fmaxf(maxY, y[i]);
+    }
+    fmm->minX = minX;
+    fmm->minY = minY;
+    fmm->width = fmaxf(fmaxf(maxX - minX, maxY - minY), 1.0f) * 1.0001f;
+
+    int cells = LevelOffset(levels + 1);
+    memset(fmm->multipoles, 0, sizeof(double) * cells * fmm->termCount);
+    memset(fmm->locals, 0, sizeof(double) * cells * fmm->termCount);
+
+    SortIntoLeaves(fmm, x, y, mass, count);
+    ParticleToMultipole(fmm);
+    for (int level = levels - 1; level >= 2; level--) {
+        MultipoleToMultipole(fmm, level);
+    }
+
+    // M2L uses the expansions of the source about its own center evaluated at the target,
+    // which flips the sign of every odd-degree term
+    for (int c = LevelOffset(2); c < cells; c++) {
+        double* M = fmm->multipoles + c * fmm->termCount;
+        for (int a = 0; a <= fmm->order; a++) {
+            for (int b = 0; a + b <= fmm->order; b++) {
+                if ((a + b) & 1) M[TermIndex(a, b)] = -M[TermIndex(a, b)];
+            }
+        }
+    }
+
+    for (int level = 2; level <= levels; level++) {
+        MultipoleToLocal(fmm, level);
+    }
+
+    for (int level = 2; level < levels; level++) {
+        LocalToLocal(fmm, level);
+    }
+    Evaluate(fmm, fx, fy);
+}
@@ -0,0 +1,38 @@
+#ifndef FMM_H
+#define FMM_H
+
+#include "gravity.h"
+
+#define FMM_MAX_ORDER 12
+
+// Fast multipole method on a uniform quadtree for the unsoftened 1/r^2 force of gravity().
+// Expansions are Cartesian Taylor series of the 1/r potential truncated at total degree order,
+// so the work per body stays constant as N grows.
+typedef struct {
+    int order;
+    int leafSize; // target mean bodies per leaf, picks the tree depth
+    int levels;
+    float minX, minY, width;
+
+    int termCount;
+    int cellCapacity;
+    double* multipoles;
+    double* locals;
+    double* derivatives; // M2L kernels for the 7x7 neighbourhood of cell offsets at unit width
+    double* levelDerivatives; // the same kernels rescaled to the current level
+
+    int leafCapacity;
+    int* leafStart;
+    int bodyCapacity;
+    int* bodies;
+    float* sortedX;
+    float* sortedY;
+    float* sortedMass;
+} Fmm;
+
+void FmmInit(Fmm* fmm, int order);
+void FmmFree(Fmm* fmm);
+// Same semantics as gravity(): G * mi * mj / r^2 towards every other body.
+void FmmForces(Fmm* fmm, const float* x, const float* y, const float* mass, int count, float* fx, float* fy);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+// Same constant the pairwise gravity() in main.c uses; every solver has to agree on it.
+#define GRAVITY_CONSTANT 6.67e-4f
+
+typedef enum {
+    GRAVITY_SOLVER_DIRECT = 0,
+    GRAVITY_SOLVER_BARNES_HUT,
+    GRAVITY_SOLVER_FMM,
+    GRAVITY_SOLVER_P3M,
+    GRAVITY_SOLVER_CUTOFF,
+    GRAVITY_SOLVER_COUNT
+} GravitySolver;
+
+#endif
@@ -1,23 +1,23 @@
 #include "math.h"
 #include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
 
 #include "raylib.h"
 #include "raymath.h"
 
-typedef struct {
-    float mass;
-    Vector2 pos;
-    Vector2 speed;
-    Vector2 size;
-    float stiffness;
-    float energyLoss;
-} ObjectDescriptor;
+#include "ensemble.h"
+#include "simthread.h"
+#include "world.h"
+
+#define MAX_OBJECTS (1 << 18)
+#define BURST_SIZE 100000
+#define FIXED_DT (1.0f / 120.0f)
+#define FRICTION 0.01f
 
 typedef struct {
     Sound sounds[4];
     int soundIndex;
-    int didBounceX;
-    int didBounceY;
 } ObjectSoundEffects;
 
 typedef struct {
@@ -29,25 +29,6 @@ typedef struct {
     Color color;
 } ObjectColorDescriptor;
 
-typedef struct {
-    ObjectDescriptor descriptor;
-    ObjectSoundEffects sf;
-    ObjectTextureDescriptor tex;
-    ObjectColorDescriptor color;
-} Object;
-
-ObjectDescriptor MakeObjectDescriptor(float mass, Vector2 pos, Vector2 speed, Vector2 size, float stiffness, float energyLoss)
-{
-    ObjectDescriptor object = {0};
-    object.mass = mass;
-    object.pos = pos;
-    object.speed = speed;
-    object.size = size;
-    object.stiffness = stiffness;
-    object.energyLoss = energyLoss;
-    return object;
-}
-
 ObjectSoundEffects MakeObjectSoundEffects(Sound sound)
 {
     ObjectSoundEffects sf;
@@ -55,43 +36,39 @@ ObjectSoundEffects MakeObjectSoundEffects(Sound sound)
         sf.sounds[i] = LoadSoundAlias(sound);
     }
     sf.soundIndex = 0;
-    sf.didBounceX = 0;
-    sf.didBounceY = 0;
     return sf;
 }
 
-void PlaySoundEffect(Object* object)
+// Simulation side of a bounce: pitch and volume of the sound object id should make, if it just
+// started touching a wall.
+bool BounceSound(const World* world, int id, Vector2* pitchVolume)
 {
-    ObjectSoundEffects* sf = &object->sf;
-    bool shouldPlaySoundX = sf->didBounceX == 1;
-    bool shouldPlaySoundY = sf->didBounceY == 1;
-    if (shouldPlaySoundX || shouldPlaySoundY) {
-        Sound sound = sf->sounds[sf->soundIndex % 4];
-        sf->soundIndex += 1;
-        float pitch = 0;
-        float volume = 0;
-        if (shouldPlaySoundX) {
-            pitch += fabsf(object->descriptor.speed.x / 1e2f);
-            volume += fabsf(object->descriptor.speed.x / 1e2f);
-        }
-        if (shouldPlaySoundY) {
-            pitch += fabsf(object->descriptor.speed.y / 1e2f);
-            volume += fabsf(object->descriptor.speed.y / 1e2f);
-        }
-        pitch = Clamp(pitch, 0.75, 2.0);
-        volume = Clamp(volume, 0.1, 1.0);
-
-        SetSoundPitch(sound, pitch);
-        SetSoundVolume(sound, volume);
-
-        PlaySound(sound);
+    bool shouldPlaySoundX = world->bounceX[id] == 1;
+    bool shouldPlaySoundY = world->bounceY[id] == 1;
+    if (!shouldPlaySoundX && !shouldPlaySoundY)
+        return false;
+    float pitch = 0;
+    float volume = 0;
+    if (shouldPlaySoundX) {
+        pitch += fabsf(world->speedX[id] / 1e2f);
+        volume += fabsf(world->speedX[id] / 1e2f);
+    }
+    if (shouldPlaySoundY) {
+        pitch += fabsf(world->speedY[id] / 1e2f);
+        volume += fabsf(world->speedY[id] / 1e2f);
     }
+    *pitchVolume = (Vector2) { Clamp(pitch, 0.75, 2.0), Clamp(volume, 0.1, 1.0) };
+    return true;
 }
 
-typedef struct {
-    Vector2 size;
-    Vector2 pos;
-} ObjectDrawDescriptor;
+void PlaySoundEffect(ObjectSoundEffects* sf, Vector2 pitchVolume)
+{
+    Sound sound = sf->sounds[sf->soundIndex % 4];
+    sf->soundIndex += 1;
+    SetSoundPitch(sound, pitchVolume.x);
+    SetSoundVolume(sound, pitchVolume.y);
+    PlaySound(sound);
+}
 
 void DrawDescriptor(ObjectDrawDescriptor* descriptor, ObjectTextureDescriptor* tex, ObjectColorDescriptor* colDesc)
 {
@@ -112,171 +89,390 @@ void DrawDescriptor(ObjectDrawDescriptor* descriptor, ObjectTextureDescriptor* t
     }
 }
 
-ObjectDrawDescriptor MakeObjectDrawDescriptor(Object* object, float dt, Vector2 extAcceleration, Vector2 extForce, float u) 
+Vector3 cosv3(Vector3 x)
 {
-    ObjectDrawDescriptor dd;
-    Vector2 imsize = object->descriptor.size;
-    float area = PI * imsize.x * imsize.y;
-    Vector2 npos = object->descriptor.pos;
-    float k = object->descriptor.stiffness;
-    float c = object->descriptor.energyLoss;
-
-    Vector2 force = Vector2Scale(extAcceleration, object->descriptor.mass);
-    force = Vector2Add(force, extForce);
-    Vector2 fritionForce = Vector2Zero();
-    float y = fminf(npos.y - imsize.y, 0.0) + fmaxf(npos.y + imsize.y - GetScreenHeight(), 0.0);
-    if (fabsf(y) > 0) {
-        object->sf.didBounceY += 1;
-        float s = object->descriptor.speed.y;
-        float N = -k * y - c * s;
-        force.y += N;
-        imsize.y -= fabsf(y);
-        imsize.x = area / (imsize.y * PI);
-        
-        fritionForce.x = -(object->descriptor.speed.x / fabsf(object->descriptor.speed.x)) * u * N;
-    } else {
-        object->sf.didBounceY = 0;
-    }
+    return (Vector3) { cosf(x.x), cosf(x.y), cosf(x.z) };
+}
 
-    float x = fminf(npos.x - imsize.x, 0.0) + fmaxf(npos.x + imsize.x - GetScreenWidth(), 0.0);
-    if (fabsf(x) > 0) {
-        object->sf.didBounceX += 1;
-        float s = object->descriptor.speed.x;
-        float N = -k * x - c * s;
-        force.x += N;
-        imsize.x -= fabsf(x);
-        imsize.y = area / (imsize.x * PI);
+Color pallete(float t)
+{
+    Vector3 a = { 0.5, 0.5, 0.5 };
+    Vector3 b = { 0.5, 0.5, 0.5 };
+    Vector3 c = { 1.0, 1.0, 1.0 };
+    Vector3 d = { 0.00, 0.10, 0.20 };
+    
+    Vector3 color = Vector3Add(a, Vector3Multiply(b, cosv3(Vector3Scale(Vector3Add(Vector3Scale(c, t), d), 6.28318f))));
+    
+    return ColorFromNormalized((Vector4) { color.x, color.y, color.z, 1.0 });
+}
 
-        fritionForce.y = (object->descriptor.speed.y / fabsf(object->descriptor.speed.y)) * u * N;
+// Everything the simulation thread owns besides the world. The render thread only reads sounds,
+// which is fixed before the thread starts; colors reach it copied into the snapshots.
+typedef struct {
+    World* world;
+    bool adaptive;
+    Vector2 extAcceleration;
+    float u;
+    ObjectSoundEffects** sounds;
+    Color* colors;
+    ObjectHandle* burst;
+    int burstCount;
+} Simulation;
+
+void StepSimulation(SimThread* sim, float dt)
+{
+    Simulation* simulation = sim->user;
+    World* world = sim->world;
+    // adaptive steps cover the same simulated time as the fixed ones
+    if (simulation->adaptive) {
+        for (float time = 0; dt - time > 1e-6f;)
+            time += WorldStepAdaptive(world, dt - time, simulation->extAcceleration, simulation->u);
     } else {
-        object->sf.didBounceX = 0;
+        WorldStep(world, dt, simulation->extAcceleration, simulation->u);
     }
-    
-    force = Vector2Add(force, fritionForce);
-    
-    dd.pos = npos;
-    dd.size = imsize;
+    for (int i = 0; i < world->count; i++) {
+        Vector2 pitchVolume;
+        if (simulation->sounds[world->objectSlot[i]] && BounceSound(world, i, &pitchVolume))
+            SimThreadEmit(sim, (SimEvent) { world->objectSlot[i], pitchVolume });
+    }
+}
 
-    if (fabsf(object->descriptor.speed.y) < 0.1 && fabsf(object->descriptor.speed.x) < 0.1 && fabsf(force.y) < 0.1 && fabsf(force.x) < 0.1) {
-        return dd;
+void DescribeSimulation(SimThread* sim, char* text, int size)
+{
+    Simulation* simulation = sim->user;
+    World* world = sim->world;
+    int length = 0;
+    if (world->collisions) {
+        int pairs = 0;
+        for (int w = 0; w < world->pairListCount; w++)
+            pairs += world->pairLists[w].count;
+        SpatialHashStats stats = world->grid.stats;
+        if (world->broadphase == BROADPHASE_TREE)
+            length += snprintf(text + length, size - length, "%d objects, %d pairs, tree height %d, %d leaves reinserted\n",
+                world->count, pairs, world->tree.root >= 0 ? world->tree.nodes[world->tree.root].height : 0, world->tree.reinserted);
+        else
+            length += snprintf(text + length, size - length, "%d objects, %d pairs, %d/%d buckets used, %.2f mean / %d max per bucket\n",
+                world->count, pairs, stats.occupied, stats.buckets, stats.meanOccupancy, stats.maxOccupancy);
     }
 
-    Vector2 acceleration = { force.x / object->descriptor.mass, force.y / object->descriptor.mass };
+    if (world->sleeping && length < size)
+        length += snprintf(text + length, size - length, "%d of %d awake, %d islands woken\n", world->awakeCount, world->count, world->wakes);
 
-    object->descriptor.speed.x += acceleration.x * dt;
-    object->descriptor.speed.y += acceleration.y * dt;
+    if (world->ccd && length < size)
+        length += snprintf(text + length, size - length, "ccd: %d swept pair impacts\n", world->sweeps);
 
-    npos.x += object->descriptor.speed.x * dt;
-    npos.y += object->descriptor.speed.y * dt;
+    if (simulation->adaptive && length < size)
+        length += snprintf(text + length, size - length, "adaptive: dt %.5f, %d accepted, %d rejected\n", world->adaptiveDt, world->accepted, world->rejected);
 
-    object->descriptor.pos = npos;
+    if (world->blockSteps && length < size)
+        length += snprintf(text + length, size - length, "blocks: %lld of %lld object-steps saved\n",
+            world->uniformObjectSteps - world->objectSteps, world->uniformObjectSteps);
 
-    dd.pos = npos;
-    dd.size = imsize;
+    if (roundf(1 / sim->dt) != 120 && length < size)
+        length += snprintf(text + length, size - length, "physics step 1/%.0f s\n", 1 / sim->dt);
 
-    return dd;
+    if (world->integrator != INTEGRATOR_EULER && length < size) {
+        const char* integrators[] = { "euler", "leapfrog", "velocity verlet", "yoshida 4th order" };
+        length += snprintf(text + length, size - length, "integrator: %s, %d force passes\n", integrators[world->integrator], world->forceEvaluations);
+    }
 }
 
-Vector3 cosv3(Vector3 x)
+// Commands the render thread posts; they run on the simulation thread between steps.
+void ApplyKey(SimThread* sim, int key, Vector2 mouse)
 {
-    return (Vector3) { cosf(x.x), cosf(x.y), cosf(x.z) };
+    Simulation* simulation = sim->user;
+    World* world = sim->world;
+    switch (key) {
+    case KEY_G:
+        world->solver = (world->solver + 1) % GRAVITY_SOLVER_COUNT;
+        break;
+    case KEY_V:
+        world->simd = !world->simd;
+        break;
+    case KEY_P:
+        world->symmetric = !world->symmetric;
+        break;
+    case KEY_C:
+        world->collisions = !world->collisions;
+        break;
+    case KEY_B:
+        world->broadphase = (world->broadphase + 1) % BROADPHASE_COUNT;
+        break;
+    case KEY_S:
+        world->sleeping = !world->sleeping;
+        break;
+    case KEY_D:
+        world->ccd = !world->ccd;
+        break;
+    case KEY_A:
+        simulation->adaptive = !simulation->adaptive;
+        break;
+    case KEY_I:
+        world->implicitContact = !world->implicitContact;
+        break;
+    case KEY_E:
+        world->integrator = (world->integrator + 1) % INTEGRATOR_COUNT;
+        break;
+    case KEY_T:
+        world->blockSteps = !world->blockSteps;
+        break;
+    case KEY_R: {
+        // 120, 60 and 30 steps per simulated second, to watch interpolation cover a slow rate
+        int rate = roundf(1 / sim->dt);
+        sim->dt = 1.0f / (rate <= 30 ? 120 : rate / 2);
+        break;
+    }
+    case KEY_N:
+        // a burst of small logos at the mouse
+        for (int i = 0; i < BURST_SIZE; i++) {
+            Vector2 pos = { mouse.x + GetRandomValue(-200, 200), mouse.y + GetRandomValue(-200, 200) };
+            Vector2 speed = { GetRandomValue(-64, 64), GetRandomValue(-64, 64) };
+            ObjectHandle handle = WorldSpawn(world, MakeObjectDescriptor(1e2, pos, speed, (Vector2) { 2, 2 }, 1e4, 1e3));
+            if (handle.slot < 0)
+                break;
+            simulation->sounds[handle.slot] = NULL;
+            simulation->colors[handle.slot] = pallete(GetRandomValue(0, 1000) / 1000.0f);
+            simulation->burst[simulation->burstCount++] = handle;
+        }
+        break;
+    case KEY_X:
+        for (int i = 0; i < simulation->burstCount; i++) {
+            WorldDespawn(world, simulation->burst[i]);
+        }
+        simulation->burstCount = 0;
+        break;
+    }
 }
 
-Color pallete(float t)
+void SetAcceleration(SimThread* sim, int arg, Vector2 acceleration)
 {
-    Vector3 a = { 0.5, 0.5, 0.5 };
-    Vector3 b = { 0.5, 0.5, 0.5 };
-    Vector3 c = { 1.0, 1.0, 1.0 };
-    Vector3 d = { 0.00, 0.10, 0.20 };
-    
-    Vector3 color = Vector3Add(a, Vector3Multiply(b, cosv3(Vector3Scale(Vector3Add(Vector3Scale(c, t), d), 6.28318f))));
-    
-    return ColorFromNormalized((Vector4) { color.x, color.y, color.z, 1.0 });
+    (void)arg;
+    ((Simulation*)sim->user)->extAcceleration = acceleration;
 }
 
-Vector2 gravity(const Object* from, const Object* to)
+// itersCount / 100 substeps of 1/120 s per 1/60 s frame, as simulated seconds per wall second
+void SetSpeed(SimThread* sim, int itersCount, Vector2 value)
 {
-    const float G = 6.67 * 1e-4;
-    Vector2 force = Vector2Zero();
-
-    Vector2 center = (Vector2) { GetScreenWidth() / 2.0f, GetScreenHeight() / 2.0f };
-    Vector2 radiusVector = Vector2Subtract(from->descriptor.pos, to->descriptor.pos);
-    float radius = Vector2Length(radiusVector);
-    float centrificForce = G * from->descriptor.mass * to->descriptor.mass / (radius * radius);
-    radiusVector = Vector2Normalize(radiusVector);
-    return Vector2Scale(radiusVector, centrificForce);
+    (void)value;
+    sim->speed = itersCount / 200.0f;
 }
 
-int main()
+void Resize(SimThread* sim, int arg, Vector2 size)
 {
-    SetConfigFlags(FLAG_MSAA_4X_HINT);
-
-    InitWindow(1200, 900, "Playground");
-    InitAudioDevice();
-
-    Sound bumpSound = LoadSound("./assets/sound_jump-90516.wav");
-
-    Texture2D texture = LoadTexture("./assets/dvd_logo.png");
-    Rectangle sourceTextureRect;
-    sourceTextureRect.x = 0;
-    sourceTextureRect.y = 0;
-    sourceTextureRect.width = texture.width;
-    sourceTextureRect.height = texture.height;
-    
-    Object objects[3] = {0};
+    (void)arg;
+    // moved walls leave sleepers hanging in the air
+    WorldWakeAll(sim->world);
+    sim->world->width = size.x;
+    sim->world->height = size.y;
+}
 
-    objects[0] = (Object) {
-        .descriptor = MakeObjectDescriptor(
+// The three logos of the session, around the middle of a world of the given size.
+void LogoDescriptors(float width, float height, ObjectDescriptor* descriptors)
+{
+    float centerX = width / 2.0f;
+    float centerY = height / 2.0f;
+    ObjectDescriptor logos[3] = {
+        MakeObjectDescriptor(
             1e9,
-            (Vector2) { GetScreenWidth() / 2.0 + 128, GetScreenHeight() / 2.0 },
+            (Vector2) { centerX + 128, centerY },
             (Vector2) { 0, 32 },
             (Vector2) { 8, 8 },
             1e12,
             1e10),
-        .sf = MakeObjectSoundEffects(bumpSound),
-        .tex = {
-            .sourceTextureRect = sourceTextureRect,
-            .texture = texture
-        },
-        .color = (ObjectColorDescriptor) { pallete(0.6) }
-    };
-    
-    objects[1] = (Object) {
-        .descriptor = MakeObjectDescriptor(
+        MakeObjectDescriptor(
             2e9,
-            (Vector2) { GetScreenWidth() / 2.0 - 128, GetScreenHeight() / 2.0 },
+            (Vector2) { centerX - 128, centerY },
             (Vector2) { 0, -32 },
             (Vector2) { 16, 16 },
             1e12,
             1e10),
-        .sf = MakeObjectSoundEffects(bumpSound),
-        .tex = {
-            .sourceTextureRect = sourceTextureRect,
-            .texture = texture
-        },
-        .color = (ObjectColorDescriptor) { pallete(0.1) }
-    };
-
-    objects[2] = (Object) {
-        .descriptor = MakeObjectDescriptor(
+        MakeObjectDescriptor(
             1e2,
-            (Vector2) { GetScreenWidth() / 2.0 - 256, GetScreenHeight() / 2.0 },
+            (Vector2) { centerX - 256, centerY },
             (Vector2) { 0, 32 },
             (Vector2) { 8, 8 },
             1e4,
             1e3),
-            
-        .sf = MakeObjectSoundEffects(bumpSound),
-        .tex = {
+    };
+    memcpy(descriptors, logos, sizeof(logos));
+}
+
+void SpawnLogos(World* world, ObjectHandle* handles)
+{
+    ObjectDescriptor descriptors[3];
+    LogoDescriptors(world->width, world->height, descriptors);
+    for (int i = 0; i < 3; i++) {
+        handles[i] = WorldSpawn(world, descriptors[i]);
+    }
+}
+
+typedef struct {
+    float width;
+    float height;
+    int steps;
+    int objects; // small logos scattered over the world besides the three
+    unsigned int seed;
+    int ensemble; // perturbed copies of the three logos to run instead, 0 for none
+    bool batched; // ensemble worlds in SIMD lanes, see WorldBatch
+} HeadlessOptions;
+
+// K copies of the session with perturbed initial conditions across the pool, and what their
+// bounces looked like.
+int RunEnsemble(HeadlessOptions options, ThreadPool* pool)
+{
+    ObjectDescriptor logos[3];
+    LogoDescriptors(options.width, options.height, logos);
+    Ensemble ensemble = MakeEnsemble(logos, 3, options.width, options.height, options.steps);
+    ensemble.dt = FIXED_DT;
+    ensemble.u = FRICTION;
+    ensemble.seed = options.seed;
+    ensemble.batched = options.batched;
+    EnsembleMember* results = malloc(sizeof(EnsembleMember) * options.ensemble);
+
+    double start = SimThreadClock();
+    EnsembleRun(&ensemble, options.ensemble, results, pool);
+    double elapsed = SimThreadClock() - start;
+    EnsembleStats stats = EnsembleSummarize(&ensemble, results, options.ensemble);
+
+    printf("%d worlds of 3 logos in %.0fx%.0f, %d threads%s: %d steps of 1/%.0f s each in %.3f s\n",
+        options.ensemble, options.width, options.height, pool->threadCount, options.batched ? ", batched" : "",
+        options.steps, 1 / FIXED_DT, elapsed);
+    printf("%.0f worlds/s, %.4g object-steps/s\n", options.ensemble / elapsed, stats.objectSteps / elapsed);
+    printf("bounces per world: %.2f mean, %.2f deviation, %.0f..%.0f\n",
+        stats.bounces.mean, stats.bounces.deviation, stats.bounces.min, stats.bounces.max);
+    for (int i = 0; i < 3; i++) {
+        printf("  logo %d: %.2f mean, %.2f deviation, %.0f..%.0f\n", i,
+            stats.objectBounces[i].mean, stats.objectBounces[i].deviation, stats.objectBounces[i].min, stats.objectBounces[i].max);
+    }
+    printf("first bounce: %.3f s mean, %.3f s deviation, %d worlds never bounced\n",
+        stats.firstBounce.mean, stats.firstBounce.deviation, stats.neverBounced);
+    printf("impact speed: %.1f px/s mean\n", stats.meanImpactSpeed);
+    free(results);
+    return 0;
+}
+
+// No window, audio or frame limit: the session's logos are stepped as fast as the machine allows
+// and the throughput is printed, for build and batch machines without a display or sound card.
+int RunHeadless(HeadlessOptions options, ThreadPool* pool)
+{
+    World world;
+    WorldInit(&world, 3 + options.objects, options.width, options.height);
+    world.pool = pool;
+    ObjectHandle handles[3];
+    SpawnLogos(&world, handles);
+    SetRandomSeed(options.seed);
+    for (int i = 0; i < options.objects; i++) {
+        Vector2 pos = { GetRandomValue(0, options.width), GetRandomValue(0, options.height) };
+        Vector2 speed = { GetRandomValue(-64, 64), GetRandomValue(-64, 64) };
+        WorldSpawn(&world, MakeObjectDescriptor(1e2, pos, speed, (Vector2) { 2, 2 }, 1e4, 1e3));
+    }
+
+    long long objectSteps = 0;
+    double start = SimThreadClock();
+    for (int step = 0; step < options.steps; step++) {
+        objectSteps += world.count;
+        WorldStep(&world, FIXED_DT, Vector2Zero(), FRICTION);
+    }
+    double elapsed = SimThreadClock() - start;
+
+    printf("%d objects in %.0fx%.0f, %d threads: %d steps of 1/%.0f s in %.3f s\n",
+        world.count, options.width, options.height, pool->threadCount, options.steps, 1 / FIXED_DT, elapsed);
+    printf("%.0f steps/s, %.4g object-steps/s, %.1f simulated seconds per second\n",
+        options.steps / elapsed, objectSteps / elapsed, options.steps * FIXED_DT / elapsed);
+    WorldFree(&world);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int threadCount = ThreadPoolDefaultThreadCount();
+    bool headless = false;
+    HeadlessOptions options = { 1200, 900, 10000, 0, 1, 0, false };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threadCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+            options.width = atof(argv[++i]);
+        else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+            options.height = atof(argv[++i]);
+        else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+            options.steps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+            options.objects = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            options.seed = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--ensemble") == 0 && i + 1 < argc)
+            options.ensemble = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--batched") == 0)
+            options.batched = true;
+    }
+
+    if (headless) {
+        ThreadPool pool;
+        ThreadPoolInit(&pool, threadCount);
+        int result = options.ensemble > 0 ? RunEnsemble(options, &pool) : RunHeadless(options, &pool);
+        ThreadPoolFree(&pool);
+        return result;
+    }
+
+    SetConfigFlags(FLAG_MSAA_4X_HINT);
+
+    InitWindow(1200, 900, "Playground");
+    InitAudioDevice();
+
+    Sound bumpSound = LoadSound("./assets/sound_jump-90516.wav");
+
+    Texture2D texture = LoadTexture("./assets/dvd_logo.png");
+    Rectangle sourceTextureRect;
+    sourceTextureRect.x = 0;
+    sourceTextureRect.y = 0;
+    sourceTextureRect.width = texture.width;
+    sourceTextureRect.height = texture.height;
+    
+    ThreadPool pool;
+    ThreadPoolInit(&pool, threadCount);
+
+    // every object the session can ever hold is allocated here, spawning never reallocates
+    World world;
+    WorldInit(&world, MAX_OBJECTS, GetScreenWidth(), GetScreenHeight());
+    world.pool = &pool;
+
+    // render and sound side tables, indexed by handle slot; burst logos stay silent
+    ObjectSoundEffects effects[3];
+    ObjectSoundEffects** sounds = calloc(MAX_OBJECTS, sizeof(ObjectSoundEffects*));
+    ObjectTextureDescriptor* textures = calloc(MAX_OBJECTS, sizeof(ObjectTextureDescriptor));
+    Color* colors = calloc(MAX_OBJECTS, sizeof(Color));
+    ObjectHandle* burst = malloc(sizeof(ObjectHandle) * MAX_OBJECTS);
+
+    ObjectHandle handles[3];
+    SpawnLogos(&world, handles);
+    float hues[3] = { 0.6, 0.1, 0.8 };
+
+    for (int i = 0; i < 3; i++) {
+        ObjectHandle handle = handles[i];
+        effects[i] = MakeObjectSoundEffects(bumpSound);
+        sounds[handle.slot] = effects + i;
+        textures[handle.slot] = (ObjectTextureDescriptor) {
             .sourceTextureRect = sourceTextureRect,
             .texture = texture
-        },
-        .color = (ObjectColorDescriptor) { pallete(0.8) }
-    };
+        };
+        colors[handle.slot] = pallete(hues[i]);
+    }
 
     float g = 9.8 * 256.0 / 10.0;
-    const float u = 0.01; // friction coef
     int itersCount = 1000;
+    int postedItersCount = -1;
+
+    // physics runs on its own thread from here on; this one only draws, plays and posts input
+    Simulation simulation = { &world, false, Vector2Zero(), FRICTION, sounds, colors, burst, 0 };
+    SimThread sim;
+    SimThreadInit(&sim, &world, FIXED_DT, &simulation);
+    sim.step = StepSimulation;
+    sim.describe = DescribeSimulation;
+    sim.slotColors = colors;
+    SimThreadStart(&sim);
 
     SetTargetFPS(60);
 
@@ -284,6 +480,10 @@ int main()
     Vector2 lastWindowPosition = GetWindowPosition();
     lastWindowPosition.y = GetRenderHeight() - lastWindowPosition.y;
     Vector2 windowAcceleration = Vector2Zero();
+    Vector2 worldSize = { world.width, world.height };
+    double lastFrame = GetTime();
+    double maxFrameSeconds = 0;
+    bool interpolate = false;
 
     while (!WindowShouldClose()) {
         Vector2 windowPosition = GetWindowPosition();
@@ -294,13 +494,12 @@ int main()
         windowAcceleration = Vector2Scale(windowAcceleration, 0.95);
         BeginDrawing();
         {
-            float t = GetTime();
-            float dt = 1.0 / 120.0;
             ClearBackground(GetColor(0));
 
             Vector2 extAcceleration = { 0, isDown ? -g : g };
             extAcceleration = Vector2Zero();
             extAcceleration = Vector2Add(extAcceleration, windowAcceleration);
+            SimThreadPost(&sim, (SimCommand) { .run = SetAcceleration, .value = extAcceleration });
 
             if (IsKeyDown(KEY_UP))
                 isDown = false;
@@ -315,34 +514,74 @@ int main()
             
             if (itersCount < 100)
                 itersCount = 100;
-            
-            ObjectDrawDescriptor drawDescriptors[3] = {0};
-            
-            for (int i = 0; i < itersCount / 100; i ++) {
-                for (int i = 0; i < 3; i++) {
-                    Vector2 grav = Vector2Zero();
-                    for (int j = 0; j < 3; j++) {
-                        if (i == j) continue;
-                        grav = Vector2Add(grav, gravity(objects + j, objects + i));
-                    }
-                    drawDescriptors[i] = MakeObjectDrawDescriptor(objects + i, dt, extAcceleration, grav, u);
-                    PlaySoundEffect(objects + i);
-                }
+
+            if (itersCount != postedItersCount && SimThreadPost(&sim, (SimCommand) { .run = SetSpeed, .arg = itersCount }))
+                postedItersCount = itersCount;
+
+            // N drops a burst of small logos at the mouse, X removes all of them again
+            int keys[] = { KEY_G, KEY_V, KEY_P, KEY_C, KEY_B, KEY_S, KEY_D, KEY_A, KEY_I, KEY_E, KEY_T, KEY_R, KEY_N, KEY_X };
+            Vector2 mouse = { GetMousePosition().x, GetScreenHeight() - GetMousePosition().y };
+            int keyCount = sizeof(keys) / sizeof(keys[0]);
+            for (int k = 0; k < keyCount; k++) {
+                if (IsKeyPressed(keys[k]))
+                    SimThreadPost(&sim, (SimCommand) { .run = ApplyKey, .arg = keys[k], .value = mouse });
             }
-            
-            for (int i = 0; i < 3; i++) {
-                DrawDescriptor(drawDescriptors + i, NULL, &objects[i].color);
+
+            Vector2 screenSize = { GetScreenWidth(), GetScreenHeight() };
+            if ((screenSize.x != worldSize.x || screenSize.y != worldSize.y) && SimThreadPost(&sim, (SimCommand) { .run = Resize, .value = screenSize }))
+                worldSize = screenSize;
+
+            // L draws one snapshot behind, in between the last two, instead of the latest as it is
+            if (IsKeyPressed(KEY_L))
+                interpolate = !interpolate;
+
+            const Snapshot* snapshot = SimThreadRead(&sim);
+            float blend = interpolate ? SnapshotBlend(snapshot, SimThreadClock()) : 1;
+            for (int i = 0; i < snapshot->count; i++) {
+                ObjectDrawDescriptor dd = SnapshotDraw(snapshot, i, blend);
+                ObjectColorDescriptor color = { snapshot->colors[i] };
+                DrawDescriptor(&dd, NULL, &color);
             }
+
+            SimEvent event;
+            while (SimThreadPollEvent(&sim, &event)) {
+                if (sounds[event.slot])
+                    PlaySoundEffect(sounds[event.slot], event.value);
+            }
+
+            DrawText(snapshot->text, 10, 10, 20, GetColor(0xFFFFFFFF));
+
+            // both sides' clocks, to see that a slow frame does not slow the steps and the other way round
+            double now = GetTime();
+            maxFrameSeconds = fmax(maxFrameSeconds, now - lastFrame);
+            lastFrame = now;
+            SimThreadStats stats = snapshot->stats;
+            SnapshotReaderStats reader = sim.readerStats;
+            DrawText(TextFormat("sim: %.0f steps/s, %.2f ms mean / %.2f ms max per step, %.2f s dropped",
+                         stats.stepsPerSecond, stats.steps ? 1e3 * stats.stepSeconds / stats.steps : 0.0, 1e3 * stats.maxStepSeconds, stats.droppedSeconds),
+                10, GetScreenHeight() - 55, 20, GetColor(0xFFFFFFFF));
+            DrawText(TextFormat("render: %d fps, %.1f ms max frame, %.1f us max read, snapshot %.1f ms old (%.1f max)%s",
+                         GetFPS(), 1e3 * maxFrameSeconds, 1e6 * reader.maxReadSeconds, 1e3 * reader.age, 1e3 * reader.maxAge,
+                         interpolate ? ", interpolated" : ""),
+                10, GetScreenHeight() - 30, 20, GetColor(0xFFFFFFFF));
         }
 
         EndDrawing();
     }
 
+    SimThreadStop(&sim);
+    SimThreadFree(&sim);
+    free(sounds);
+    free(textures);
+    free(colors);
+    free(burst);
+    WorldFree(&world);
+    ThreadPoolFree(&pool);
+
     CloseAudioDevice();
     CloseWindow();
     return 0;
 }
 
 // TODO: bouncing in circle
-// TODO: more objects and collisions between objects
 // TODO: create sound from vibrations and etc (simulate sound, not just play some wav)
@@ -0,0 +1,136 @@
+#include "narrowphase.h"
+
+#include "math.h"
+#include "stdbool.h"
+
+#define NARROWPHASE_SAMPLES 16
+#define NARROWPHASE_STEPS 6
+#define SAMPLE_COS 0.92387953f // 22.5 degrees between samples
+#define SAMPLE_SIN 0.38268343f
+
+static inline float Overlap(float a2x, float a2y, float b2x, float b2y, float dx, float dy, float nx, float ny)
+{
+    return sqrtf(a2x * nx * nx + a2y * ny * ny) + sqrtf(b2x * nx * nx + b2y * ny * ny) - (dx * nx + dy * ny);
+}
+
+// Safeguarded Newton on f(theta), n = (cos theta, sin theta), for the minimum within one sample
+// spacing of (nx, ny). Each support term contributes (b^2 - a^2) c s / g to f' and
+// (b^2 - a^2) ((c^2 - s^2) / g - (b^2 - a^2) c^2 s^2 / g^3) to f''. The sign of f' shrinks the
+// bracket [lo, hi]; a Newton step that leaves it, or a concave spot, falls back to halving the
+// angle. Flattened shapes make f nearly V-shaped, where Newton alone overshoots.
+static float Refine(float a2x, float a2y, float b2x, float b2y, float dx, float dy, float* normalX, float* normalY)
+{
+    float nx = *normalX, ny = *normalY;
+    float loX = nx * SAMPLE_COS + ny * SAMPLE_SIN, loY = ny * SAMPLE_COS - nx * SAMPLE_SIN;
+    float hiX = nx * SAMPLE_COS - ny * SAMPLE_SIN, hiY = ny * SAMPLE_COS + nx * SAMPLE_SIN;
+    float ka = a2y - a2x, kb = b2y - b2x;
+    for (int it = 0; it < NARROWPHASE_STEPS; it++) {
+        float cs = nx * ny;
+        float cc = nx * nx - ny * ny;
+        float ga = sqrtf(a2x * nx * nx + a2y * ny * ny);
+        float gb = sqrtf(b2x * nx * nx + b2y * ny * ny);
+        float d1 = ka * cs / ga + kb * cs / gb + dx * ny - dy * nx;
+        float d2 = ka * (cc / ga - ka * cs * cs / (ga * ga * ga)) + kb * (cc / gb - kb * cs * cs / (gb * gb * gb)) + dx * nx + dy * ny;
+
+        bool rising = d1 > 0;
+        hiX = rising ? nx : hiX;
+        hiY = rising ? ny : hiY;
+        loX = rising ? loX : nx;
+        loY = rising ? loY : ny;
+
+        // rotate by atan(step), close enough to step for Newton
+        float step = -d1 / d2;
+        float tx = nx - step * ny, ty = ny + step * nx;
+        // tiny steps are taken as they are: near convergence n sits on an end of the bracket
+        bool inside = d2 > 0 && (fabsf(step) < 1e-3f || (loX * ty - loY * tx > 0 && tx * hiY - ty * hiX > 0));
+        tx = inside ? tx : loX + hiX;
+        ty = inside ? ty : loY + hiY;
+        float inverse = 1.0f / sqrtf(tx * tx + ty * ty);
+        nx = tx * inverse;
+        ny = ty * inverse;
+    }
+    *normalX = nx;
+    *normalY = ny;
+    return Overlap(a2x, a2y, b2x, b2y, dx, dy, nx, ny);
+}
+
+EllipseContact EllipseEllipseContact(float ax, float ay, float aSizeX, float aSizeY, float bx, float by, float bSizeX, float bSizeY)
+{
+    float dx = bx - ax, dy = by - ay;
+    float a2x = aSizeX * aSizeX, a2y = aSizeY * aSizeY;
+    float b2x = bSizeX * bSizeX, b2y = bSizeY * bSizeY;
+
+    EllipseContact contact;
+    // separated along the line of centres, which covers most broadphase candidates that do not
+    // touch, or two circles, for which that line is the answer
+    float d = sqrtf(dx * dx + dy * dy);
+    bool circles = a2x == a2y && b2x == b2y;
+    if (d > 0) {
+        float nx = dx / d, ny = dy / d;
+        float ga = sqrtf(a2x * nx * nx + a2y * ny * ny);
+        float gb = sqrtf(b2x * nx * nx + b2y * ny * ny);
+        if (ga + gb < d || circles) {
+            contact.depth = ga + gb - d;
+            contact.normalX = nx;
+            contact.normalY = ny;
+            contact.pointX = ax + 0.5f * (a2x * nx / ga + dx - b2x * nx / gb);
+            contact.pointY = ay + 0.5f * (a2y * ny / ga + dy - b2y * ny / gb);
+            return contact;
+        }
+    }
+
+    // a ring of directions; f can have two basins when the overlap is deep, so the two lowest
+    // local minima of the ring both get refined
+    float f[NARROWPHASE_SAMPLES], ringX[NARROWPHASE_SAMPLES], ringY[NARROWPHASE_SAMPLES];
+    float sx = 1, sy = 0;
+    for (int k = 0; k < NARROWPHASE_SAMPLES; k++) {
+        ringX[k] = sx;
+        ringY[k] = sy;
+        f[k] = Overlap(a2x, a2y, b2x, b2y, dx, dy, sx, sy);
+        float rx = sx * SAMPLE_COS - sy * SAMPLE_SIN;
+        sy = sx * SAMPLE_SIN + sy * SAMPLE_COS;
+        sx = rx;
+    }
+    int first = 0, second = 0;
+    float firstF = INFINITY, secondF = INFINITY;
+    for (int k = 0; k < NARROWPHASE_SAMPLES; k++) {
+        float v = f[k];
+        bool minimum = v <= f[(k + NARROWPHASE_SAMPLES - 1) % NARROWPHASE_SAMPLES] && v <= f[(k + 1) % NARROWPHASE_SAMPLES];
+        bool beatsFirst = minimum && v < firstF;
+        bool beatsSecond = minimum && !beatsFirst && v < secondF;
+        second = beatsFirst ? first : beatsSecond ? k : second;
+        secondF = beatsFirst ? firstF : beatsSecond ? v : secondF;
+        first = beatsFirst ? k : first;
+        firstF = beatsFirst ? v : firstF;
+    }
+    float nx = ringX[first], ny = ringY[first];
+    float depth = Refine(a2x, a2y, b2x, b2y, dx, dy, &nx, &ny);
+    // a second basin only matters for overlapping pairs
+    if (secondF < INFINITY && depth > 0) {
+        float mx = ringX[second], my = ringY[second];
+        float other = Refine(a2x, a2y, b2x, b2y, dx, dy, &mx, &my);
+        bool swap = other < depth;
+        nx = swap ? mx : nx;
+        ny = swap ? my : ny;
+    }
+
+    float ga = sqrtf(a2x * nx * nx + a2y * ny * ny);
+    float gb = sqrtf(b2x * nx * nx + b2y * ny * ny);
+    contact.depth = ga + gb - (dx * nx + dy * ny);
+    contact.normalX = nx;
+    contact.normalY = ny;
+    // support points: A's furthest along n, B's furthest along -n
+    float pax = ax + a2x * nx / ga, pay = ay + a2y * ny / ga;
+    float pbx = bx - b2x * nx / gb, pby = by - b2y * ny / gb;
+    contact.pointX = 0.5f * (pax + pbx);
+    contact.pointY = 0.5f * (pay + pby);
+    return contact;
+}
+
+void EllipseContacts(const float* x, const float* y, const float* sizeX, const float* sizeY, const BodyPair* pairs, int count, EllipseContact* contacts)
+{
+    for (int p = 0; p < count; p++) {
+        int a = pairs[p].a, b = pairs[p].b;
+        contacts[p] = EllipseEllipseContact(x[a], y[a], sizeX[a], sizeY[a], x[b], y[b], sizeX[b], sizeY[b]);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include "broadphase.h"
+
+typedef struct {
+    float depth; // penetration depth; when the ellipses are apart some negative value, not their distance
+    float normalX; // unit, from the first ellipse towards the second
+    float normalY;
+    float pointX; // halfway between the deepest points of the two ellipses
+    float pointY;
+} EllipseContact;
+
+// Axis-aligned ellipses with centre (x, y) and half axes (sizeX, sizeY), like the drawn logos.
+// The depth is the shortest translation that separates them, min over unit n of
+// hA(n) + hB(n) - (cB - cA) . n with h the support function sqrt(a^2 nx^2 + b^2 ny^2), found by
+// sampling a few directions and refining with a fixed number of Newton steps on the angle.
+EllipseContact EllipseEllipseContact(float ax, float ay, float aSizeX, float aSizeY, float bx, float by, float bSizeX, float bSizeY);
+// EllipseEllipseContact for every pair, reading the bodies out of the arrays.
+void EllipseContacts(const float* x, const float* y, const float* sizeX, const float* sizeY, const BodyPair* pairs, int count, EllipseContact* contacts);
+
+#endif
@@ -0,0 +1,172 @@
+#include "neighborlist.h"
+
+#include "math.h"
+#include "stdlib.h"
+#include "string.h"
+
+void NeighborListInit(NeighborList* nl, float cutoff, float skin, float softening)
+{
+    memset(nl, 0, sizeof(*nl));
+    nl->cutoff = cutoff;
+    nl->skin = skin;
+    nl->softening = softening;
+    nl->count = -1;
+}
+
+void NeighborListFree(NeighborList* nl)
+{
+    free(nl->buildX);
+    free(nl->buildY);
+    free(nl->start);
+    free(nl->neighbors);
+    free(nl->cellStart);
+    free(nl->cellBodies);
+    free(nl->bodyCell);
+    memset(nl, 0, sizeof(*nl));
+}
+
+void NeighborListInvalidate(NeighborList* nl)
+{
+    nl->count = -1;
+}
+
+static bool Stale(const NeighborList* nl, const float* x, const float* y, int count, int moving)
+{
+    if (nl->count != count) return true;
+    float limit = 0.25f * nl->skin * nl->skin;
+    for (int i = 0; i < moving; i++) {
+        float dx = x[i] - nl->buildX[i];
+        float dy = y[i] - nl->buildY[i];
+        // also catches NaN positions
+        if (!(dx * dx + dy * dy <= limit)) return true;
+    }
+    return false;
+}
+
+static void Build(NeighborList* nl, const float* x, const float* y, int count)
+{
+    if (count > nl->bodyCapacity) {
+        nl->buildX = realloc(nl->buildX, sizeof(float) * count);
+        nl->buildY = realloc(nl->buildY, sizeof(float) * count);
+        nl->start = realloc(nl->start, sizeof(int) * (count + 1));
+        nl->cellBodies = realloc(nl->cellBodies, sizeof(int) * count);
+        nl->bodyCell = realloc(nl->bodyCell, sizeof(int) * count);
+        nl->bodyCapacity = count;
+    }
+    memcpy(nl->buildX, x, sizeof(float) * count);
+    memcpy(nl->buildY, y, sizeof(float) * count);
+
+    float minX = x[0], minY = y[0], maxX = x[0], maxY = y[0];
+    for (int i = 1; i < count; i++) {
+        minX = fminf(minX, x[i]);
+        minY = fminf(minY, y[i]);
+        maxX = fmaxf(maxX, x[i]);
+        maxY = fmaxf(maxY, y[i]);
+    }
+    // cells of at least cutoff + skin, coarser when a few strays would blow up the grid
+    float reach = nl->cutoff + nl->skin;
+    float cell = reach;
+    int cellsX, cellsY;
+    for (;;) {
+        cellsX = (int)((maxX - minX) / cell) + 1;
+        cellsY = (int)((maxY - minY) / cell) + 1;
+        if ((long)cellsX * cellsY <= 4L * count + 16) break;
+        cell *= 2;
+    }
+    int cells = cellsX * cellsY;
+    if (cells + 1 > nl->cellCapacity) {
+        nl->cellStart = realloc(nl->cellStart, sizeof(int) * (cells + 1));
+        nl->cellCapacity = cells + 1;
+    }
+
+    memset(nl->cellStart, 0, sizeof(int) * (cells + 1));
+    for (int i = 0; i < count; i++) {
+        int cx = (int)((x[i] - minX) / cell);
+        int cy = (int)((y[i] - minY) / cell);
+        cx = cx < 0 ? 0 : cx >= cellsX ? cellsX - 1 : cx;
+        cy = cy < 0 ? 0 : cy >= cellsY ? cellsY - 1 : cy;
+        nl->bodyCell[i] = cy * cellsX + cx;
+        nl->cellStart[nl->bodyCell[i] + 1] += 1;
+    }
+    for (int c = 0; c < cells; c++) {
+        nl->cellStart[c + 1] += nl->cellStart[c];
+    }
+    for (int i = 0; i < count; i++) {
+        nl->cellBodies[nl->cellStart[nl->bodyCell[i]]++] = i;
+    }
+    for (int c = cells; c > 0; c--) {
+        nl->cellStart[c] = nl->cellStart[c - 1];
+    }
+    nl->cellStart[0] = 0;
+
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        nl->start[i] = total;
+        int cx = nl->bodyCell[i] % cellsX;
+        int cy = nl->bodyCell[i] / cellsX;
+        for (int ny = cy - 1; ny <= cy + 1; ny++) {
+            for (int nx = cx - 1; nx <= cx + 1; nx++) {
+                if (nx < 0 || ny < 0 || nx >= cellsX || ny >= cellsY) continue;
+                int c = ny * cellsX + nx;
+                for (int k = nl->cellStart[c]; k < nl->cellStart[c + 1]; k++) {
+                    int j = nl->cellBodies[k];
+                    if (j == i) continue;
+                    float dx = x[j] - x[i];
+                    float dy = y[j] - y[i];
+                    if (dx * dx + dy * dy >= reach * reach) continue;
+                    if (total == nl->neighborCapacity) {
+                        nl->neighborCapacity = nl->neighborCapacity ? nl->neighborCapacity * 2 : 1024;
+                        nl->neighbors = realloc(nl->neighbors, sizeof(int) * nl->neighborCapacity);
+                    }
+                    nl->neighbors[total++] = j;
+                }
+            }
+        }
+    }
+    nl->start[count] = total;
+    nl->count = count;
+    nl->builds += 1;
+}
+
+bool NeighborListUpdate(NeighborList* nl, const float* x, const float* y, int count)
+{
+    return NeighborListUpdateMoving(nl, x, y, count, count);
+}
+
+bool NeighborListUpdateMoving(NeighborList* nl, const float* x, const float* y, int count, int moving)
+{
+    nl->updates += 1;
+    if (count == 0 || !Stale(nl, x, y, count, moving)) return false;
+    Build(nl, x, y, count);
+    return true;
+}
+
+void NeighborListForce(const NeighborList* nl, const float* x, const float* y, const float* mass, int i, float* fx, float* fy)
+{
+    float rc2 = nl->cutoff * nl->cutoff;
+    float eps2 = nl->softening * nl->softening;
+    float ax = 0, ay = 0;
+    for (int k = nl->start[i]; k < nl->start[i + 1]; k++) {
+        int j = nl->neighbors[k];
+        float dx = x[j] - x[i];
+        float dy = y[j] - y[i];
+        float r2 = dx * dx + dy * dy;
+        if (r2 >= rc2) continue;
+        float d2 = r2 + eps2;
+        // only reachable with zero softening and coincident bodies
+        if (d2 <= 0) continue;
+        float s = mass[j] / (d2 * sqrtf(d2));
+        ax += dx * s;
+        ay += dy * s;
+    }
+    *fx = GRAVITY_CONSTANT * mass[i] * ax;
+    *fy = GRAVITY_CONSTANT * mass[i] * ay;
+}
+
+void NeighborListForces(NeighborList* nl, const float* x, const float* y, const float* mass, int count, float* fx, float* fy)
+{
+    NeighborListUpdate(nl, x, y, count);
+    for (int i = 0; i < count; i++) {
+        NeighborListForce(nl, x, y, mass, i, fx + i, fy + i);
+    }
+}
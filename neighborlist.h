@@ -0,0 +1,48 @@
+#ifndef NEIGHBORLIST_H
+#define NEIGHBORLIST_H
+
+#include "stdbool.h"
+
+#include "gravity.h"
+
+// Short-range gravity with Plummer softening, G * mi * mj * d / (r^2 + softening^2)^(3/2) for
+// pairs closer than cutoff and nothing beyond. Pairs come from a Verlet list of everything
+// within cutoff + skin, which stays valid until some body has moved more than skin / 2 since
+// the list was built, so the cell sort runs every few steps instead of every step.
+typedef struct {
+    float cutoff;
+    float skin;
+    float softening;
+
+    int count; // bodies in the last build, -1 forces a rebuild
+    int builds;
+    int updates;
+    float* buildX; // positions at the last build
+    float* buildY;
+    int* start; // neighbors of body i are neighbors[start[i], start[i + 1])
+    int* neighbors;
+    int neighborCapacity;
+    int bodyCapacity;
+
+    // cell list used by the build
+    int* cellStart;
+    int cellCapacity;
+    int* cellBodies;
+    int* bodyCell;
+} NeighborList;
+
+void NeighborListInit(NeighborList* nl, float cutoff, float skin, float softening);
+void NeighborListFree(NeighborList* nl);
+// Call when bodies were added, removed or reordered.
+void NeighborListInvalidate(NeighborList* nl);
+// Rebuilds the list when it is stale; returns true when it did.
+bool NeighborListUpdate(NeighborList* nl, const float* x, const float* y, int count);
+// NeighborListUpdate for when only bodies [0, moving) can have moved since the last build, so
+// the staleness check skips the rest.
+bool NeighborListUpdateMoving(NeighborList* nl, const float* x, const float* y, int count, int moving);
+// Force on body i from its listed neighbors; the list has to be up to date.
+void NeighborListForce(const NeighborList* nl, const float* x, const float* y, const float* mass, int i, float* fx, float* fy);
+// Updates the list and writes the force for every body.
+void NeighborListForces(NeighborList* nl, const float* x, const float* y, const float* mass, int count, float* fx, float* fy);
+
+#endif
@@ -0,0 +1,266 @@
+#include "particlemesh.h"
+
+#include "math.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define PM_PI 3.14159265358979323846
+
+void ParticleMeshInit(ParticleMesh* pm, int gridSize, float cutoff)
+{
+    memset(pm, 0, sizeof(*pm));
+    int n = 2;
+    while (n < gridSize) n *= 2;
+    pm->gridSize = n;
+    pm->cutoff = cutoff;
+}
+
+void ParticleMeshFree(ParticleMesh* pm)
+{
+    free(pm->green);
+    free(pm->mesh);
+    free(pm->column);
+    free(pm->gradX);
+    free(pm->gradY);
+    free(pm->cellStart);
+    free(pm->cellBodies);
+    free(pm->bodyCell);
+    memset(pm, 0, sizeof(*pm));
+}
+
+// In-place radix-2 FFT of n interleaved complex values, unnormalized.
+static void Fft(double* data, int n, int inverse)
+{
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            double re = data[2 * i], im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        double angle = (inverse ? 2 : -2) * PM_PI / len;
+        double wr = cos(angle), wi = sin(angle);
+        for (int i = 0; i < n; i += len) {
+            double cr = 1, ci = 0;
+            for (int k = 0; k < len / 2; k++) {
+                double* a = data + 2 * (i + k);
+                double* b = data + 2 * (i + k + len / 2);
+                double tr = b[0] * cr - b[1] * ci;
+                double ti = b[0] * ci + b[1] * cr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+                double ncr = cr * wr - ci * wi;
+                ci = cr * wi + ci * wr;
+                cr = ncr;
+            }
+        }
+    }
+}
+
+static void Fft2D(double* data, double* column, int n, int inverse)
+{
+    for (int row = 0; row < n; row++) {
+        Fft(data + 2 * row * n, n, inverse);
+    }
+    for (int col = 0; col < n; col++) {
+        for (int row = 0; row < n; row++) {
+            column[2 * row] = data[2 * (row * n + col)];
+            column[2 * row + 1] = data[2 * (row * n + col) + 1];
+        }
+        Fft(column, n, inverse);
+        for (int row = 0; row < n; row++) {
+            data[2 * (row * n + col)] = column[2 * row];
+            data[2 * (row * n + col) + 1] = column[2 * row + 1];
+        }
+    }
+}
+
+static void BuildGreen(ParticleMesh* pm, float width, float height)
+{
+    int n = pm->gridSize;
+    int padded = 2 * n;
+    if (pm->cachedGridSize != n) {
+        pm->green = realloc(pm->green, sizeof(double) * 2 * padded * padded);
+        pm->mesh = realloc(pm->mesh, sizeof(double) * 2 * padded * padded);
+        pm->column = realloc(pm->column, sizeof(double) * 2 * padded);
+        pm->gradX = realloc(pm->gradX, sizeof(float) * n * n);
+        pm->gradY = realloc(pm->gradY, sizeof(float) * n * n);
+    }
+
+    double hx = width / n;
+    double hy = height / n;
+    double rs = fmax(pm->cutoff / 3.0, PM_SPLIT_CELLS * fmax(hx, hy));
+    pm->splitRadius = rs;
+    pm->shortCutoff = fmaxf(pm->cutoff, 3 * rs);
+    for (int j = 0; j < padded; j++) {
+        for (int i = 0; i < padded; i++) {
+            // wrapped displacement; index n is never reached by a real pair in the padded box
+            int di = i < n ? i : i - padded;
+            int dj = j < n ? j : j - padded;
+            double g = 0;
+            if (i != n && j != n) {
+                double r = sqrt(di * hx * di * hx + dj * hy * dj * hy);
+                g = r > 0 ? erf(r / rs) / r : 2.0 / (sqrt(PM_PI) * rs);
+            }
+            pm->green[2 * (j * padded + i)] = g;
+            pm->green[2 * (j * padded + i) + 1] = 0;
+        }
+    }
+    Fft2D(pm->green, pm->column, padded, 0);
+
+    pm->width = width;
+    pm->height = height;
+    pm->cachedCutoff = pm->cutoff;
+    pm->cachedGridSize = n;
+}
+
+// Cloud-in-cell stencil: the lower-left node and the weights towards the upper-right one.
+static void CloudInCell(const ParticleMesh* pm, float x, float y, int* i0, int* j0, float* wx, float* wy)
+{
+    int n = pm->gridSize;
+    float u = x / pm->width * n - 0.5f;
+    float v = y / pm->height * n - 0.5f;
+    u = fminf(fmaxf(u, 0), n - 1);
+    v = fminf(fmaxf(v, 0), n - 1);
+    *i0 = (int)u < n - 1 ? (int)u : n - 2;
+    *j0 = (int)v < n - 1 ? (int)v : n - 2;
+    *wx = u - *i0;
+    *wy = v - *j0;
+}
+
+static void LongRange(ParticleMesh* pm, const float* x, const float* y, const float* mass, int count, float* fx, float* fy)
+{
+    int n = pm->gridSize;
+    int padded = 2 * n;
+    double* mesh = pm->mesh;
+    memset(mesh, 0, sizeof(double) * 2 * padded * padded);
+
+    for (int b = 0; b < count; b++) {
+        int i, j;
+        float wx, wy;
+        CloudInCell(pm, x[b], y[b], &i, &j, &wx, &wy);
+        mesh[2 * (j * padded + i)] += mass[b] * (1 - wx) * (1 - wy);
+        mesh[2 * (j * padded + i + 1)] += mass[b] * wx * (1 - wy);
+        mesh[2 * ((j + 1) * padded + i)] += mass[b] * (1 - wx) * wy;
+        mesh[2 * ((j + 1) * padded + i + 1)] += mass[b] * wx * wy;
+    }
+
+    Fft2D(mesh, pm->column, padded, 0);
+    for (int k = 0; k < padded * padded; k++) {
+        double re = mesh[2 * k] * pm->green[2 * k] - mesh[2 * k + 1] * pm->green[2 * k + 1];
+        double im = mesh[2 * k] * pm->green[2 * k + 1] + mesh[2 * k + 1] * pm->green[2 * k];
+        mesh[2 * k] = re;
+        mesh[2 * k + 1] = im;
+    }
+    Fft2D(mesh, pm->column, padded, 1);
+
+    double norm = 1.0 / ((double)padded * padded);
+    double hx = pm->width / n;
+    double hy = pm->height / n;
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            int il = i > 0 ? i - 1 : i, ir = i < n - 1 ? i + 1 : i;
+            int jl = j > 0 ? j - 1 : j, jr = j < n - 1 ? j + 1 : j;
+            double phiL = mesh[2 * (j * padded + il)], phiR = mesh[2 * (j * padded + ir)];
+            double phiD = mesh[2 * (jl * padded + i)], phiU = mesh[2 * (jr * padded + i)];
+            pm->gradX[j * n + i] = (phiR - phiL) * norm / ((ir - il) * hx);
+            pm->gradY[j * n + i] = (phiU - phiD) * norm / ((jr - jl) * hy);
+        }
+    }
+
+    for (int b = 0; b < count; b++) {
+        int i, j;
+        float wx, wy;
+        CloudInCell(pm, x[b], y[b], &i, &j, &wx, &wy);
+        float gx = pm->gradX[j * n + i] * (1 - wx) * (1 - wy) + pm->gradX[j * n + i + 1] * wx * (1 - wy)
+            + pm->gradX[(j + 1) * n + i] * (1 - wx) * wy + pm->gradX[(j + 1) * n + i + 1] * wx * wy;
+        float gy = pm->gradY[j * n + i] * (1 - wx) * (1 - wy) + pm->gradY[j * n + i + 1] * wx * (1 - wy)
+            + pm->gradY[(j + 1) * n + i] * (1 - wx) * wy + pm->gradY[(j + 1) * n + i + 1] * wx * wy;
+        fx[b] = GRAVITY_CONSTANT * mass[b] * gx;
+        fy[b] = GRAVITY_CONSTANT * mass[b] * gy;
+    }
+}
+
+static void ShortRange(ParticleMesh* pm, const float* x, const float* y, const float* mass, int count, float* fx, float* fy)
+{
+    float rc = pm->shortCutoff;
+    float rs = pm->splitRadius;
+    int cellsX = (int)fmaxf(1, pm->width / rc);
+    int cellsY = (int)fmaxf(1, pm->height / rc);
+    int cells = cellsX * cellsY;
+    if (cells + 1 > pm->cellCapacity) {
+        pm->cellStart = realloc(pm->cellStart, sizeof(int) * (cells + 1));
+        pm->cellCapacity = cells + 1;
+    }
+    if (count > pm->bodyCapacity) {
+        pm->cellBodies = realloc(pm->cellBodies, sizeof(int) * count);
+        pm->bodyCell = realloc(pm->bodyCell, sizeof(int) * count);
+        pm->bodyCapacity = count;
+    }
+
+    memset(pm->cellStart, 0, sizeof(int) * (cells + 1));
+    for (int b = 0; b < count; b++) {
+        int cx = (int)(x[b] / pm->width * cellsX);
+        int cy = (int)(y[b] / pm->height * cellsY);
+        cx = cx < 0 ? 0 : cx >= cellsX ? cellsX - 1 : cx;
+        cy = cy < 0 ? 0 : cy >= cellsY ? cellsY - 1 : cy;
+        pm->bodyCell[b] = cy * cellsX + cx;
+        pm->cellStart[pm->bodyCell[b] + 1] += 1;
+    }
+    for (int c = 0; c < cells; c++) {
+        pm->cellStart[c + 1] += pm->cellStart[c];
+    }
+    for (int b = 0; b < count; b++) {
+        pm->cellBodies[pm->cellStart[pm->bodyCell[b]]++] = b;
+    }
+    for (int c = cells; c > 0; c--) {
+        pm->cellStart[c] = pm->cellStart[c - 1];
+    }
+    pm->cellStart[0] = 0;
+
+    const float twoOverSqrtPi = 2.0f / sqrtf(PM_PI);
+    for (int b = 0; b < count; b++) {
+        int cx = pm->bodyCell[b] % cellsX;
+        int cy = pm->bodyCell[b] / cellsX;
+        float ax = 0, ay = 0;
+        for (int ny = cy - 1; ny <= cy + 1; ny++) {
+            for (int nx = cx - 1; nx <= cx + 1; nx++) {
+                if (nx < 0 || ny < 0 || nx >= cellsX || ny >= cellsY) continue;
+                int cell = ny * cellsX + nx;
+                for (int k = pm->cellStart[cell]; k < pm->cellStart[cell + 1]; k++) {
+                    int o = pm->cellBodies[k];
+                    if (o == b) continue;
+                    float dx = x[o] - x[b];
+                    float dy = y[o] - y[b];
+                    float r2 = dx * dx + dy * dy;
+                    if (r2 >= rc * rc) continue;
+                    float r = sqrtf(r2);
+                    // -d/dr of erfc(r/rs)/r, i.e. what the mesh leaves out of 1/r^2
+                    float q = r / rs;
+                    float s = mass[o] * (erfcf(q) + twoOverSqrtPi * q * expf(-q * q)) / (r2 * r);
+                    ax += dx * s;
+                    ay += dy * s;
+                }
+            }
+        }
+        fx[b] += GRAVITY_CONSTANT * mass[b] * ax;
+        fy[b] += GRAVITY_CONSTANT * mass[b] * ay;
+    }
+}
+
+void ParticleMeshForces(ParticleMesh* pm, float width, float height, const float* x, const float* y, const float* mass, int count, float* fx, float* fy)
+{
+    if (pm->cachedGridSize != pm->gridSize || pm->width != width || pm->height != height || pm->cachedCutoff != pm->cutoff) {
+        BuildGreen(pm, width, height);
+    }
+    LongRange(pm, x, y, mass, count, fx, fy);
+    ShortRange(pm, x, y, mass, count, fx, fy);
+}
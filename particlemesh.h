@@ -0,0 +1,44 @@
+#ifndef PARTICLEMESH_H
+#define PARTICLEMESH_H
+
+#include "gravity.h"
+
+// Smallest split radius in mesh cells: closer to the cell size the mesh force is off by percents.
+#define PM_SPLIT_CELLS 4
+
+// Particle-particle/particle-mesh (P3M) gravity over a width x height box.
+// The 1/r potential is split into a smooth erf(r/rs)/r part, solved on a zero-padded
+// gridSize x gridSize mesh with FFTs, and an erfc(r/rs)/r part summed directly for pairs
+// closer than cutoff, so close encounters keep the exact force of gravity().
+// rs = cutoff / 3, but at least PM_SPLIT_CELLS mesh cells; a cutoff too short for the mesh is
+// raised to 3 rs.
+typedef struct {
+    int gridSize; // power of two
+    float cutoff;
+    float splitRadius; // rs and the cutoff in use, derived from cutoff and the mesh spacing
+    float shortCutoff;
+
+    // Green's function cache, rebuilt when the box or the split changes
+    float width, height;
+    float cachedCutoff;
+    int cachedGridSize;
+    double* green; // FFT of the long-range kernel, interleaved complex, padded 2n x 2n
+    double* mesh;
+    double* column;
+    float* gradX;
+    float* gradY;
+
+    // cell list for the short-range pass
+    int cellCapacity;
+    int* cellStart;
+    int bodyCapacity;
+    int* cellBodies;
+    int* bodyCell;
+} ParticleMesh;
+
+void ParticleMeshInit(ParticleMesh* pm, int gridSize, float cutoff);
+void ParticleMeshFree(ParticleMesh* pm);
+// Same semantics as gravity(): G * mi * mj / r^2 towards every other body.
+void ParticleMeshForces(ParticleMesh* pm, float width, float height, const float* x, const float* y, const float* mass, int count, float* fx, float* fy);
+
+#endif
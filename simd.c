@@ -0,0 +1,448 @@
+#include "simd.h"
+
+#include "math.h"
+
+#if defined(__AVX2__)
+#include "immintrin.h"
+
+#define SIMD_WIDTH 8
+#define SIMD_NAME "AVX2"
+
+typedef __m256 VFloat;
+typedef __m256 VMask;
+typedef __m256i VInt;
+
+static inline VFloat VSet(float v) { return _mm256_set1_ps(v); }
+static inline VFloat VLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void VStore(float* p, VFloat v) { _mm256_storeu_ps(p, v); }
+static inline VFloat VAdd(VFloat a, VFloat b) { return _mm256_add_ps(a, b); }
+static inline VFloat VSub(VFloat a, VFloat b) { return _mm256_sub_ps(a, b); }
+static inline VFloat VMul(VFloat a, VFloat b) { return _mm256_mul_ps(a, b); }
+static inline VFloat VDiv(VFloat a, VFloat b) { return _mm256_div_ps(a, b); }
+// min/max return the second operand when the first is NaN, like fminf(x, 0)
+static inline VFloat VMin(VFloat a, VFloat b) { return _mm256_min_ps(a, b); }
+static inline VFloat VMax(VFloat a, VFloat b) { return _mm256_max_ps(a, b); }
+static inline VFloat VAbs(VFloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+static inline VFloat VRsqrt(VFloat a) { return _mm256_rsqrt_ps(a); }
+static inline VFloat VSqrt(VFloat a) { return _mm256_sqrt_ps(a); }
+static inline VMask VLess(VFloat a, VFloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline VMask VGreater(VFloat a, VFloat b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline VMask VAnd(VMask a, VMask b) { return _mm256_and_ps(a, b); }
+static inline VFloat VSelect(VMask m, VFloat a, VFloat b) { return _mm256_blendv_ps(b, a, m); }
+static inline VInt VLoadInt(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline void VStoreInt(int* p, VInt v) { _mm256_storeu_si256((__m256i*)p, v); }
+static inline VInt VZeroInt(void) { return _mm256_setzero_si256(); }
+static inline VInt VIncrementInt(VInt a) { return _mm256_add_epi32(a, _mm256_set1_epi32(1)); }
+static inline VInt VSelectInt(VMask m, VInt a, VInt b)
+{
+    return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), m));
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include "arm_neon.h"
+
+#define SIMD_WIDTH 4
+#define SIMD_NAME "NEON"
+
+typedef float32x4_t VFloat;
+typedef uint32x4_t VMask;
+typedef int32x4_t VInt;
+
+static inline VFloat VSet(float v) { return vdupq_n_f32(v); }
+static inline VFloat VLoad(const float* p) { return vld1q_f32(p); }
+static inline void VStore(float* p, VFloat v) { vst1q_f32(p, v); }
+static inline VFloat VAdd(VFloat a, VFloat b) { return vaddq_f32(a, b); }
+static inline VFloat VSub(VFloat a, VFloat b) { return vsubq_f32(a, b); }
+static inline VFloat VMul(VFloat a, VFloat b) { return vmulq_f32(a, b); }
+static inline VFloat VDiv(VFloat a, VFloat b) { return vdivq_f32(a, b); }
+// minNum/maxNum ignore a NaN operand, like fminf
+static inline VFloat VMin(VFloat a, VFloat b) { return vminnmq_f32(a, b); }
+static inline VFloat VMax(VFloat a, VFloat b) { return vmaxnmq_f32(a, b); }
+static inline VFloat VAbs(VFloat a) { return vabsq_f32(a); }
+// the NEON estimate has ~8 bits, one step here brings it to the ~12 bits of rsqrtps
+static inline VFloat VRsqrt(VFloat a)
+{
+    VFloat e = vrsqrteq_f32(a);
+    return vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+}
+static inline VFloat VSqrt(VFloat a) { return vsqrtq_f32(a); }
+static inline VMask VLess(VFloat a, VFloat b) { return vcltq_f32(a, b); }
+static inline VMask VGreater(VFloat a, VFloat b) { return vcgtq_f32(a, b); }
+static inline VMask VAnd(VMask a, VMask b) { return vandq_u32(a, b); }
+static inline VFloat VSelect(VMask m, VFloat a, VFloat b) { return vbslq_f32(m, a, b); }
+static inline VInt VLoadInt(const int* p) { return vld1q_s32(p); }
+static inline void VStoreInt(int* p, VInt v) { vst1q_s32(p, v); }
+static inline VInt VZeroInt(void) { return vdupq_n_s32(0); }
+static inline VInt VIncrementInt(VInt a) { return vaddq_s32(a, vdupq_n_s32(1)); }
+static inline VInt VSelectInt(VMask m, VInt a, VInt b) { return vbslq_s32(m, a, b); }
+
+#elif defined(__SSE2__)
+#include "emmintrin.h"
+
+#define SIMD_WIDTH 4
+#define SIMD_NAME "SSE2"
+
+typedef __m128 VFloat;
+typedef __m128 VMask;
+typedef __m128i VInt;
+
+static inline VFloat VSet(float v) { return _mm_set1_ps(v); }
+static inline VFloat VLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void VStore(float* p, VFloat v) { _mm_storeu_ps(p, v); }
+static inline VFloat VAdd(VFloat a, VFloat b) { return _mm_add_ps(a, b); }
+static inline VFloat VSub(VFloat a, VFloat b) { return _mm_sub_ps(a, b); }
+static inline VFloat VMul(VFloat a, VFloat b) { return _mm_mul_ps(a, b); }
+static inline VFloat VDiv(VFloat a, VFloat b) { return _mm_div_ps(a, b); }
+static inline VFloat VMin(VFloat a, VFloat b) { return _mm_min_ps(a, b); }
+static inline VFloat VMax(VFloat a, VFloat b) { return _mm_max_ps(a, b); }
+static inline VFloat VAbs(VFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline VFloat VRsqrt(VFloat a) { return _mm_rsqrt_ps(a); }
+static inline VFloat VSqrt(VFloat a) { return _mm_sqrt_ps(a); }
+static inline VMask VLess(VFloat a, VFloat b) { return _mm_cmplt_ps(a, b); }
+static inline VMask VGreater(VFloat a, VFloat b) { return _mm_cmpgt_ps(a, b); }
+static inline VMask VAnd(VMask a, VMask b) { return _mm_and_ps(a, b); }
+// no blendv before SSE4.1
+static inline VFloat VSelect(VMask m, VFloat a, VFloat b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline VInt VLoadInt(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void VStoreInt(int* p, VInt v) { _mm_storeu_si128((__m128i*)p, v); }
+static inline VInt VZeroInt(void) { return _mm_setzero_si128(); }
+static inline VInt VIncrementInt(VInt a) { return _mm_add_epi32(a, _mm_set1_epi32(1)); }
+static inline VInt VSelectInt(VMask m, VInt a, VInt b)
+{
+    __m128i mi = _mm_castps_si128(m);
+    return _mm_or_si128(_mm_and_si128(mi, a), _mm_andnot_si128(mi, b));
+}
+
+#else
+
+#define SIMD_WIDTH 1
+#define SIMD_NAME "scalar"
+
+typedef float VFloat;
+typedef int VMask;
+typedef int VInt;
+
+static inline VFloat VSet(float v) { return v; }
+static inline VFloat VLoad(const float* p) { return *p; }
+static inline void VStore(float* p, VFloat v) { *p = v; }
+static inline VFloat VAdd(VFloat a, VFloat b) { return a + b; }
+static inline VFloat VSub(VFloat a, VFloat b) { return a - b; }
+static inline VFloat VMul(VFloat a, VFloat b) { return a * b; }
+static inline VFloat VDiv(VFloat a, VFloat b) { return a / b; }
+static inline VFloat VMin(VFloat a, VFloat b) { return fminf(a, b); }
+static inline VFloat VMax(VFloat a, VFloat b) { return fmaxf(a, b); }
+static inline VFloat VAbs(VFloat a) { return fabsf(a); }
+static inline VFloat VRsqrt(VFloat a) { return 1.0f / sqrtf(a); }
+static inline VFloat VSqrt(VFloat a) { return sqrtf(a); }
+static inline VMask VLess(VFloat a, VFloat b) { return a < b; }
+static inline VMask VGreater(VFloat a, VFloat b) { return a > b; }
+static inline VMask VAnd(VMask a, VMask b) { return a && b; }
+static inline VFloat VSelect(VMask m, VFloat a, VFloat b) { return m ? a : b; }
+static inline VInt VLoadInt(const int* p) { return *p; }
+static inline void VStoreInt(int* p, VInt v) { *p = v; }
+static inline VInt VZeroInt(void) { return 0; }
+static inline VInt VIncrementInt(VInt a) { return a + 1; }
+static inline VInt VSelectInt(VMask m, VInt a, VInt b) { return m ? a : b; }
+
+#endif
+
+int SimdWidth(void)
+{
+    return SIMD_WIDTH;
+}
+
+const char* SimdName(void)
+{
+    return SIMD_NAME;
+}
+
+// -1, 0 or 1; speed / |speed| is NaN for an object at rest
+static inline VFloat VSign(VFloat a)
+{
+    return VSelect(VGreater(a, VSet(0)), VSet(1), VSelect(VLess(a, VSet(0)), VSet(-1), VSet(0)));
+}
+
+static inline float VSum(VFloat v)
+{
+    float lanes[SIMD_WIDTH];
+    VStore(lanes, v);
+    float sum = 0;
+    for (int l = 0; l < SIMD_WIDTH; l++) {
+        sum += lanes[l];
+    }
+    return sum;
+}
+
+void SimdGravityDirect(const float* x, const float* y, const float* mass, int count, int begin, int end, float* fx, float* fy)
+{
+    const VFloat zero = VSet(0);
+    const VFloat half = VSet(0.5f);
+    const VFloat threeHalves = VSet(1.5f);
+    int vectorEnd = count / SIMD_WIDTH * SIMD_WIDTH;
+
+    for (int i = begin; i < end; i++) {
+        VFloat xi = VSet(x[i]);
+        VFloat yi = VSet(y[i]);
+        VFloat ax = zero, ay = zero;
+        for (int j = 0; j < vectorEnd; j += SIMD_WIDTH) {
+            VFloat dx = VSub(VLoad(x + j), xi);
+            VFloat dy = VSub(VLoad(y + j), yi);
+            VFloat r2 = VAdd(VMul(dx, dx), VMul(dy, dy));
+            // one Newton-Raphson step on the hardware estimate: inv * (1.5 - 0.5 * r2 * inv^2)
+            VFloat inv = VRsqrt(r2);
+            inv = VMul(inv, VSub(threeHalves, VMul(VMul(half, r2), VMul(inv, inv))));
+            VFloat s = VMul(VLoad(mass + j), VMul(inv, VMul(inv, inv)));
+            // drops i == j, whose 0 * inf turned into NaN above
+            s = VSelect(VGreater(r2, zero), s, zero);
+            ax = VAdd(ax, VMul(dx, s));
+            ay = VAdd(ay, VMul(dy, s));
+        }
+        float sumX = VSum(ax);
+        float sumY = VSum(ay);
+        for (int j = vectorEnd; j < count; j++) {
+            float dx = x[j] - x[i];
+            float dy = y[j] - y[i];
+            float r2 = dx * dx + dy * dy;
+            if (r2 <= 0) continue;
+            float s = mass[j] / (r2 * sqrtf(r2));
+            sumX += dx * s;
+            sumY += dy * s;
+        }
+        fx[i] = GRAVITY_CONSTANT * mass[i] * sumX;
+        fy[i] = GRAVITY_CONSTANT * mass[i] * sumY;
+    }
+}
+
+void SimdGravityRow(const float* x, const float* y, const float* mass, int count, int i, float* accX, float* accY)
+{
+    const VFloat zero = VSet(0);
+    const VFloat half = VSet(0.5f);
+    const VFloat threeHalves = VSet(1.5f);
+    VFloat xi = VSet(x[i]);
+    VFloat yi = VSet(y[i]);
+    VFloat mi = VSet(mass[i]);
+    VFloat ax = zero, ay = zero;
+    int j = i + 1;
+    int vectorEnd = j + (count - j) / SIMD_WIDTH * SIMD_WIDTH;
+
+    for (; j < vectorEnd; j += SIMD_WIDTH) {
+        VFloat dx = VSub(VLoad(x + j), xi);
+        VFloat dy = VSub(VLoad(y + j), yi);
+        VFloat r2 = VAdd(VMul(dx, dx), VMul(dy, dy));
+        VFloat inv = VRsqrt(r2);
+        inv = VMul(inv, VSub(threeHalves, VMul(VMul(half, r2), VMul(inv, inv))));
+        VFloat inv3 = VSelect(VGreater(r2, zero), VMul(inv, VMul(inv, inv)), zero);
+        VFloat si = VMul(VLoad(mass + j), inv3);
+        VFloat sj = VMul(mi, inv3);
+        ax = VAdd(ax, VMul(dx, si));
+        ay = VAdd(ay, VMul(dy, si));
+        // the j accumulators are contiguous, so the equal and opposite half is a plain load/store
+        VStore(accX + j, VSub(VLoad(accX + j), VMul(dx, sj)));
+        VStore(accY + j, VSub(VLoad(accY + j), VMul(dy, sj)));
+    }
+    float sumX = VSum(ax);
+    float sumY = VSum(ay);
+    for (; j < count; j++) {
+        float dx = x[j] - x[i];
+        float dy = y[j] - y[i];
+        float r2 = dx * dx + dy * dy;
+        if (r2 <= 0) continue;
+        float inv3 = 1.0f / (r2 * sqrtf(r2));
+        sumX += dx * mass[j] * inv3;
+        sumY += dy * mass[j] * inv3;
+        accX[j] -= dx * mass[i] * inv3;
+        accY[j] -= dy * mass[i] * inv3;
+    }
+    accX[i] += sumX;
+    accY[i] += sumY;
+}
+
+// WallNormal in lanes.
+static inline VFloat VWallNormal(bool implicit, VFloat y, VFloat v, VFloat force, VFloat mass, VFloat k, VFloat c, VFloat step)
+{
+    if (implicit) {
+        VFloat stepPerMass = VDiv(step, mass);
+        VFloat denominator = VAdd(VAdd(VSet(1), VMul(stepPerMass, c)), VMul(VMul(stepPerMass, step), k));
+        v = VDiv(VAdd(v, VMul(stepPerMass, VSub(force, VMul(k, y)))), denominator);
+        y = VAdd(y, VMul(step, v));
+    }
+    return VSub(VMul(VSub(VSet(0), k), y), VMul(c, v));
+}
+
+// The arrays one contact step reads and writes, from a World or a WorldBatch.
+typedef struct {
+    float* posX;
+    float* posY;
+    float* speedX;
+    float* speedY;
+    const float* mass;
+    const float* sizeX;
+    const float* sizeY;
+    const float* stiffness;
+    const float* energyLoss;
+    const float* forceX;
+    const float* forceY;
+    int* touchX;
+    int* touchY;
+    float* drawSizeX;
+    float* drawSizeY;
+} ContactArrays;
+
+#define CONTACT_ARRAYS(source) { (source)->posX, (source)->posY, (source)->speedX, (source)->speedY, (source)->mass, \
+    (source)->sizeX, (source)->sizeY, (source)->stiffness, (source)->energyLoss, (source)->forceX, (source)->forceY, \
+    (source)->touchX, (source)->touchY, (source)->drawSizeX, (source)->drawSizeY }
+
+typedef struct {
+    VFloat width;
+    VFloat height;
+    VFloat accX;
+    VFloat accY;
+    VFloat friction;
+    VFloat step;
+    VFloat move;
+    bool implicit;
+} ContactConstants;
+
+static inline ContactConstants MakeContactConstants(float width, float height, Vector2 extAcceleration, float u, float kick, float drift, bool implicit)
+{
+    return (ContactConstants) { VSet(width), VSet(height), VSet(extAcceleration.x), VSet(extAcceleration.y), VSet(u), VSet(kick), VSet(drift), implicit };
+}
+
+// MakeObjectDrawDescriptor for the lanes starting at i.
+static inline void ContactLanes(const ContactArrays* a, int i, const ContactConstants* constants)
+{
+    const VFloat zero = VSet(0);
+    const VFloat pi = VSet(PI);
+    const VFloat rest = VSet(0.1f);
+    const VFloat friction = constants->friction;
+    const VFloat step = constants->step;
+    const VFloat move = constants->move;
+
+    VFloat sizeX = VLoad(a->sizeX + i);
+    VFloat sizeY = VLoad(a->sizeY + i);
+    VFloat area = VMul(VMul(pi, sizeX), sizeY);
+    VFloat posX = VLoad(a->posX + i);
+    VFloat posY = VLoad(a->posY + i);
+    VFloat speedX = VLoad(a->speedX + i);
+    VFloat speedY = VLoad(a->speedY + i);
+    VFloat mass = VLoad(a->mass + i);
+    VFloat k = VLoad(a->stiffness + i);
+    VFloat c = VLoad(a->energyLoss + i);
+
+    VFloat forceX = VAdd(VMul(constants->accX, mass), VLoad(a->forceX + i));
+    VFloat forceY = VAdd(VMul(constants->accY, mass), VLoad(a->forceY + i));
+
+    // floor/ceiling: every lane computes the contact, the mask decides what sticks
+    VFloat y = VAdd(VMin(VSub(posY, sizeY), zero), VMax(VSub(VAdd(posY, sizeY), constants->height), zero));
+    VMask hitY = VGreater(VAbs(y), zero);
+    VFloat normalY = VWallNormal(constants->implicit, y, speedY, forceY, mass, k, c, step);
+    forceY = VSelect(hitY, VAdd(forceY, normalY), forceY);
+    sizeY = VSelect(hitY, VSub(sizeY, VAbs(y)), sizeY);
+    sizeX = VSelect(hitY, VDiv(area, VMul(sizeY, pi)), sizeX);
+    VFloat frictionX = VMul(VMul(VSub(zero, VSign(speedX)), friction), normalY);
+    frictionX = VSelect(hitY, frictionX, zero);
+    VInt touchY = VLoadInt(a->touchY + i);
+    VStoreInt(a->touchY + i, VSelectInt(hitY, VIncrementInt(VZeroInt()), touchY));
+
+    // side walls, against the size already squished by the floor
+    VFloat x = VAdd(VMin(VSub(posX, sizeX), zero), VMax(VSub(VAdd(posX, sizeX), constants->width), zero));
+    VMask hitX = VGreater(VAbs(x), zero);
+    VFloat normalX = VWallNormal(constants->implicit, x, speedX, forceX, mass, k, c, step);
+    forceX = VSelect(hitX, VAdd(forceX, normalX), forceX);
+    sizeX = VSelect(hitX, VSub(sizeX, VAbs(x)), sizeX);
+    sizeY = VSelect(hitX, VDiv(area, VMul(sizeX, pi)), sizeY);
+    VFloat frictionY = VMul(VMul(VSign(speedY), friction), normalX);
+    frictionY = VSelect(hitX, frictionY, zero);
+    VInt touchX = VLoadInt(a->touchX + i);
+    VStoreInt(a->touchX + i, VSelectInt(hitX, VIncrementInt(VZeroInt()), touchX));
+
+    forceX = VAdd(forceX, frictionX);
+    forceY = VAdd(forceY, frictionY);
+    VStore(a->drawSizeX + i, sizeX);
+    VStore(a->drawSizeY + i, sizeY);
+
+    VMask resting = VAnd(VAnd(VLess(VAbs(speedY), rest), VLess(VAbs(speedX), rest)),
+        VAnd(VLess(VAbs(forceY), rest), VLess(VAbs(forceX), rest)));
+    VFloat newSpeedX = VAdd(speedX, VMul(VDiv(forceX, mass), step));
+    VFloat newSpeedY = VAdd(speedY, VMul(VDiv(forceY, mass), step));
+    newSpeedX = VSelect(resting, speedX, newSpeedX);
+    newSpeedY = VSelect(resting, speedY, newSpeedY);
+    VStore(a->speedX + i, newSpeedX);
+    VStore(a->speedY + i, newSpeedY);
+    VStore(a->posX + i, VSelect(resting, posX, VAdd(posX, VMul(newSpeedX, move))));
+    VStore(a->posY + i, VSelect(resting, posY, VAdd(posY, VMul(newSpeedY, move))));
+}
+
+void SimdContactIntegrate(World* world, int begin, int end, float kick, float drift, Vector2 extAcceleration, float u)
+{
+    ContactArrays arrays = CONTACT_ARRAYS(world);
+    ContactConstants constants = MakeContactConstants(world->width, world->height, extAcceleration, u, kick, drift, world->implicitContact);
+    int vectorEnd = begin + (end - begin) / SIMD_WIDTH * SIMD_WIDTH;
+    for (int i = begin; i < vectorEnd; i += SIMD_WIDTH) {
+        ContactLanes(&arrays, i, &constants);
+    }
+
+    WorldContactIntegrate(world, vectorEnd, end, kick, drift, extAcceleration, u);
+}
+
+// GravityRow of object i in the worlds of lanes [lane, lane + SIMD_WIDTH).
+static inline void BatchGravityRow(WorldBatch* batch, int i, int lane)
+{
+    const VFloat zero = VSet(0);
+    const VFloat one = VSet(1);
+    int at = i * WORLD_BATCH_LANES + lane;
+    VFloat xi = VLoad(batch->posX + at);
+    VFloat yi = VLoad(batch->posY + at);
+    VFloat mi = VLoad(batch->mass + at);
+    VFloat sumX = zero, sumY = zero;
+    for (int j = i + 1; j < batch->count; j++) {
+        int other = j * WORLD_BATCH_LANES + lane;
+        VFloat dx = VSub(VLoad(batch->posX + other), xi);
+        VFloat dy = VSub(VLoad(batch->posY + other), yi);
+        VFloat r2 = VAdd(VMul(dx, dx), VMul(dy, dy));
+        // a coincident pair in one world skips only its own lane
+        VFloat inv3 = VSelect(VGreater(r2, zero), VDiv(one, VMul(r2, VSqrt(r2))), zero);
+        VFloat mj = VLoad(batch->mass + other);
+        sumX = VAdd(sumX, VMul(VMul(dx, mj), inv3));
+        sumY = VAdd(sumY, VMul(VMul(dy, mj), inv3));
+        VStore(batch->accX + other, VSub(VLoad(batch->accX + other), VMul(VMul(dx, mi), inv3)));
+        VStore(batch->accY + other, VSub(VLoad(batch->accY + other), VMul(VMul(dy, mi), inv3)));
+    }
+    VStore(batch->accX + at, VAdd(VLoad(batch->accX + at), sumX));
+    VStore(batch->accY + at, VAdd(VLoad(batch->accY + at), sumY));
+}
+
+void SimdBatchGravity(WorldBatch* batch)
+{
+    const VFloat zero = VSet(0);
+    const VFloat G = VSet(GRAVITY_CONSTANT);
+    int count = batch->count;
+    for (int lane = 0; lane < WORLD_BATCH_LANES; lane += SIMD_WIDTH) {
+        for (int k = 0; k < (count + 1) / 2; k++) {
+            int mirror = count - 1 - k;
+            BatchGravityRow(batch, k, lane);
+            if (mirror != k) {
+                BatchGravityRow(batch, mirror, lane);
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            int at = i * WORLD_BATCH_LANES + lane;
+            // summed onto zero like GravityReduceTask, which turns -0 into 0
+            VFloat ax = VAdd(zero, VLoad(batch->accX + at));
+            VFloat ay = VAdd(zero, VLoad(batch->accY + at));
+            VStore(batch->forceX + at, VMul(VMul(G, VLoad(batch->mass + at)), ax));
+            VStore(batch->forceY + at, VMul(VMul(G, VLoad(batch->mass + at)), ay));
+            VStore(batch->accX + at, zero);
+            VStore(batch->accY + at, zero);
+        }
+    }
+}
+
+void SimdBatchContactIntegrate(WorldBatch* batch, float dt, Vector2 extAcceleration, float u)
+{
+    ContactArrays arrays = CONTACT_ARRAYS(batch);
+    ContactConstants constants = MakeContactConstants(batch->width, batch->height, extAcceleration, u, dt, dt, batch->implicitContact);
+    for (int i = 0; i < batch->count * WORLD_BATCH_LANES; i += SIMD_WIDTH) {
+        ContactLanes(&arrays, i, &constants);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "batch.h"
+#include "world.h"
+
+// Vector kernels for the direct gravity sum and the wall-contact step. The instruction set
+// is picked at compile time: AVX2 (8 lanes, build with -mavx2), NEON or SSE2 (4 lanes),
+// otherwise plain floats. The scalar code in world.c stays the reference they must match.
+int SimdWidth(void);
+const char* SimdName(void);
+
+// Same result as the direct solver for bodies [begin, end), with a refined reciprocal square
+// root per pair. Coincident bodies contribute nothing instead of NaN.
+void SimdGravityDirect(const float* x, const float* y, const float* mass, int count, int begin, int end, float* fx, float* fy);
+// One row of the symmetric direct sum: pairs (i, j > i), adding sum mj * d / r^3 to acc[i] and
+// subtracting mi * d / r^3 from acc[j]. Forces are G * m * acc once every row is done.
+void SimdGravityRow(const float* x, const float* y, const float* mass, int count, int i, float* accX, float* accY);
+// Branchless MakeObjectDrawDescriptor over objects [begin, end).
+void SimdContactIntegrate(World* world, int begin, int end, float kick, float drift, Vector2 extAcceleration, float u);
+// Symmetric direct gravity of every world in the batch, each lane summing its pairs in the order
+// the scalar GravityPairs does, with an exact square root and division.
+void SimdBatchGravity(WorldBatch* batch);
+// SimdContactIntegrate across the worlds of the batch, one Euler step of dt.
+void SimdBatchContactIntegrate(WorldBatch* batch, float dt, Vector2 extAcceleration, float u);
+
+#endif
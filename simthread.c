@@ -0,0 +1,257 @@
+#include "simthread.h"
+
+#include "math.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#define SNAPSHOT_FRESH 4
+
+double SimThreadClock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void SleepSeconds(double seconds)
+{
+    struct timespec ts = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&ts, NULL);
+}
+
+static void SimQueueInit(SimQueue* queue, int itemSize)
+{
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    queue->items = malloc((size_t)itemSize * SIM_THREAD_QUEUE);
+    queue->itemSize = itemSize;
+}
+
+static bool SimQueuePush(SimQueue* queue, const void* item)
+{
+    int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    int head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head >= SIM_THREAD_QUEUE) return false;
+    memcpy(queue->items + (size_t)(tail % SIM_THREAD_QUEUE) * queue->itemSize, item, queue->itemSize);
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static bool SimQueuePop(SimQueue* queue, void* item)
+{
+    int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) return false;
+    memcpy(item, queue->items + (size_t)(head % SIM_THREAD_QUEUE) * queue->itemSize, queue->itemSize);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+void SimThreadInit(SimThread* sim, World* world, float dt, void* user)
+{
+    memset(sim, 0, sizeof(SimThread));
+    sim->world = world;
+    sim->dt = dt;
+    sim->speed = 1;
+    sim->maxLag = 0.1;
+    sim->publishInterval = 1.0 / 240.0;
+    sim->user = user;
+    SimQueueInit(&sim->commands, sizeof(SimCommand));
+    SimQueueInit(&sim->events, sizeof(SimEvent));
+    for (int b = 0; b < 3; b++) {
+        sim->snapshots.buffers[b].draw = malloc(sizeof(ObjectDrawDescriptor) * world->capacity);
+        sim->snapshots.buffers[b].previous = malloc(sizeof(ObjectDrawDescriptor) * world->capacity);
+        sim->snapshots.buffers[b].slots = malloc(sizeof(int) * world->capacity);
+        sim->snapshots.buffers[b].colors = malloc(sizeof(Color) * world->capacity);
+    }
+    sim->lastDraw = malloc(sizeof(ObjectDrawDescriptor) * world->capacity);
+    sim->lastGeneration = malloc(sizeof(unsigned int) * world->capacity);
+    memset(sim->lastGeneration, 0xFF, sizeof(unsigned int) * world->capacity);
+    sim->snapshots.front = 0;
+    atomic_init(&sim->snapshots.middle, 1);
+    sim->snapshots.back = 2;
+    atomic_init(&sim->quit, false);
+}
+
+void SimThreadFree(SimThread* sim)
+{
+    free(sim->commands.items);
+    free(sim->events.items);
+    for (int b = 0; b < 3; b++) {
+        free(sim->snapshots.buffers[b].draw);
+        free(sim->snapshots.buffers[b].previous);
+        free(sim->snapshots.buffers[b].slots);
+        free(sim->snapshots.buffers[b].colors);
+    }
+    free(sim->lastDraw);
+    free(sim->lastGeneration);
+}
+
+bool SimThreadPost(SimThread* sim, SimCommand command)
+{
+    return SimQueuePush(&sim->commands, &command);
+}
+
+bool SimThreadEmit(SimThread* sim, SimEvent event)
+{
+    return SimQueuePush(&sim->events, &event);
+}
+
+bool SimThreadPollEvent(SimThread* sim, SimEvent* event)
+{
+    return SimQueuePop(&sim->events, event);
+}
+
+static void Publish(SimThread* sim, double now, double accumulator)
+{
+    TripleBuffer* buffer = &sim->snapshots;
+    Snapshot* snapshot = buffer->buffers + buffer->back;
+    World* world = sim->world;
+    snapshot->count = world->count;
+    for (int i = 0; i < world->count; i++) {
+        int slot = world->objectSlot[i];
+        ObjectDrawDescriptor draw = WorldDrawDescriptor(world, i);
+        // a slot that was free or held another object last time has nothing to start from
+        bool known = sim->lastGeneration[slot] == world->slotGeneration[slot];
+        snapshot->draw[i] = draw;
+        snapshot->previous[i] = known ? sim->lastDraw[slot] : draw;
+        snapshot->slots[i] = slot;
+        if (sim->slotColors) {
+            snapshot->colors[i] = sim->slotColors[slot];
+        }
+        sim->lastDraw[slot] = draw;
+        sim->lastGeneration[slot] = world->slotGeneration[slot];
+    }
+    snapshot->simTime = sim->simTime;
+    snapshot->previousSimTime = sim->lastSimTime;
+    snapshot->wallTime = now;
+    snapshot->lead = accumulator;
+    snapshot->speed = sim->speed;
+    sim->lastSimTime = sim->simTime;
+    sim->stats.published += 1;
+    snapshot->stats = sim->stats;
+    snapshot->text[0] = 0;
+    if (sim->describe) {
+        sim->describe(sim, snapshot->text, SIM_THREAD_TEXT);
+    }
+    // release: the reader that takes this index sees everything written above
+    int previous = atomic_exchange_explicit(&buffer->middle, buffer->back | SNAPSHOT_FRESH, memory_order_acq_rel);
+    buffer->back = previous & ~SNAPSHOT_FRESH;
+}
+
+const Snapshot* SimThreadRead(SimThread* sim)
+{
+    double start = SimThreadClock();
+    TripleBuffer* buffer = &sim->snapshots;
+    SnapshotReaderStats* stats = &sim->readerStats;
+    bool fresh = atomic_load_explicit(&buffer->middle, memory_order_relaxed) & SNAPSHOT_FRESH;
+    if (fresh) {
+        int previous = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+        buffer->front = previous & ~SNAPSHOT_FRESH;
+    }
+    const Snapshot* snapshot = buffer->buffers + buffer->front;
+    double now = SimThreadClock();
+    stats->reads += 1;
+    stats->freshReads += fresh;
+    stats->maxReadSeconds = fmax(stats->maxReadSeconds, now - start);
+    if (snapshot->wallTime > 0) {
+        stats->age = now - snapshot->wallTime;
+        stats->maxAge = fmax(stats->maxAge, stats->age);
+    }
+    return snapshot;
+}
+
+float SnapshotBlend(const Snapshot* snapshot, double now)
+{
+    double gap = snapshot->simTime - snapshot->previousSimTime;
+    if (gap <= 0) return 1;
+    double blend = (snapshot->lead + (now - snapshot->wallTime) * snapshot->speed) / gap;
+    return blend < 0 ? 0 : blend > 1 ? 1 : blend;
+}
+
+ObjectDrawDescriptor SnapshotDraw(const Snapshot* snapshot, int i, float blend)
+{
+    ObjectDrawDescriptor from = snapshot->previous[i], to = snapshot->draw[i];
+    return (ObjectDrawDescriptor) {
+        .size = { from.size.x + (to.size.x - from.size.x) * blend, from.size.y + (to.size.y - from.size.y) * blend },
+        .pos = { from.pos.x + (to.pos.x - from.pos.x) * blend, from.pos.y + (to.pos.y - from.pos.y) * blend },
+    };
+}
+
+static void* SimThreadMain(void* argument)
+{
+    SimThread* sim = argument;
+    double last = SimThreadClock();
+    double lastPublish = 0;
+    double rateStart = last;
+    long long rateSteps = 0;
+    double accumulator = 0;
+    bool unpublished = false;
+    while (!atomic_load_explicit(&sim->quit, memory_order_acquire)) {
+        SimCommand command;
+        while (SimQueuePop(&sim->commands, &command)) {
+            command.run(sim, command.arg, command.value);
+        }
+
+        double now = SimThreadClock();
+        accumulator += (now - last) * sim->speed;
+        last = now;
+        // a backlog the steps cannot catch up on is dropped instead of growing every frame
+        double maxBacklog = sim->maxLag * sim->speed;
+        if (accumulator > maxBacklog) {
+            sim->stats.droppedSeconds += accumulator - maxBacklog;
+            accumulator = maxBacklog;
+        }
+
+        while (accumulator >= sim->dt && !atomic_load_explicit(&sim->quit, memory_order_relaxed)) {
+            double start = SimThreadClock();
+            sim->step(sim, sim->dt);
+            double elapsed = SimThreadClock() - start;
+            sim->stats.steps += 1;
+            sim->stats.stepSeconds += elapsed;
+            sim->stats.maxStepSeconds = fmax(sim->stats.maxStepSeconds, elapsed);
+            sim->simTime += sim->dt;
+            accumulator -= sim->dt;
+            unpublished = true;
+            // slow steps publish between themselves, so the renderer does not wait out a backlog
+            now = SimThreadClock();
+            if (now - lastPublish >= sim->publishInterval) {
+                Publish(sim, now, accumulator);
+                lastPublish = now;
+                unpublished = false;
+            }
+        }
+
+        now = SimThreadClock();
+        if (now - rateStart >= 1) {
+            sim->stats.stepsPerSecond = (sim->stats.steps - rateSteps) / (now - rateStart);
+            rateStart = now;
+            rateSteps = sim->stats.steps;
+        }
+        if (unpublished && now - lastPublish >= sim->publishInterval) {
+            Publish(sim, now, accumulator);
+            lastPublish = now;
+            unpublished = false;
+        }
+
+        // until the next step is due, or a short nap while paused
+        double wait = sim->speed > 0 ? (sim->dt - accumulator) / sim->speed : 1e-3;
+        if (wait > 0) {
+            SleepSeconds(wait < 1e-3 ? wait : 1e-3);
+        }
+    }
+    return NULL;
+}
+
+void SimThreadStart(SimThread* sim)
+{
+    atomic_store(&sim->quit, false);
+    pthread_create(&sim->thread, NULL, SimThreadMain, sim);
+}
+
+void SimThreadStop(SimThread* sim)
+{
+    atomic_store_explicit(&sim->quit, true, memory_order_release);
+    pthread_join(sim->thread, NULL);
+}
@@ -0,0 +1,133 @@
+#ifndef SIMTHREAD_H
+#define SIMTHREAD_H
+
+#include "pthread.h"
+#include "stdatomic.h"
+#include "stdbool.h"
+
+#include "world.h"
+
+#define SIM_THREAD_TEXT 1024
+#define SIM_THREAD_QUEUE 4096
+
+typedef struct SimThread SimThread;
+
+// Measured on the simulation thread and copied into every snapshot, so the renderer reads them
+// without sharing anything.
+typedef struct {
+    long long steps;
+    long long published;
+    double stepSeconds; // wall time spent stepping, in total
+    double maxStepSeconds;
+    double droppedSeconds; // simulated time given up because stepping fell behind
+    double stepsPerSecond; // over the last full second
+} SimThreadStats;
+
+// Measured on the render thread by SimThreadRead.
+typedef struct {
+    long long reads;
+    long long freshReads; // reads that found a newer snapshot
+    double maxReadSeconds;
+    double age; // wall seconds since the snapshot last read was published
+    double maxAge;
+} SnapshotReaderStats;
+
+// One physics state as the renderer sees it, with the one published before it for interpolation.
+typedef struct {
+    int count;
+    double simTime; // simulated seconds
+    double previousSimTime; // of the snapshot before
+    double wallTime; // when it was published, on SimThreadClock
+    double lead; // simulated seconds already due at wallTime but not stepped yet
+    float speed; // simulated seconds per wall second
+    ObjectDrawDescriptor* draw;
+    ObjectDrawDescriptor* previous; // the same objects in the snapshot before; new ones copy draw
+    int* slots; // handle slot of each descriptor, for the caller's side tables
+    Color* colors; // slotColors of each descriptor, as they were when it was published
+    SimThreadStats stats;
+    char text[SIM_THREAD_TEXT]; // status lines from the describe callback
+} Snapshot;
+
+// Lock-free triple buffer. The writer fills back and swaps it with the shared middle buffer; the
+// reader swaps middle with front only when something was published since its last look. Neither
+// side waits for the other, and the reader always holds a complete snapshot.
+typedef struct {
+    Snapshot buffers[3];
+    _Alignas(64) atomic_int middle; // index, with SNAPSHOT_FRESH set until the reader takes it
+    int back; // writer only
+    int front; // reader only
+} TripleBuffer;
+
+// Single-producer single-consumer ring of fixed-size items.
+typedef struct {
+    _Alignas(64) atomic_int head; // next to pop, consumer
+    _Alignas(64) atomic_int tail; // next to push, producer
+    char* items;
+    int itemSize;
+} SimQueue;
+
+// Runs on the simulation thread between steps, the only place the renderer may change the world.
+typedef struct {
+    void (*run)(SimThread* sim, int arg, Vector2 value);
+    int arg;
+    Vector2 value;
+} SimCommand;
+
+// Something that happened during a step for the render thread, such as a bounce to play.
+typedef struct {
+    int slot;
+    Vector2 value;
+} SimEvent;
+
+// Steps a world on its own thread with a fixed-step accumulator: every speed * elapsed wall
+// seconds are covered by fixed steps of dt, so the simulation keeps its rate whatever the
+// renderer does. More than maxLag wall seconds of backlog are dropped instead of spiralling.
+struct SimThread {
+    World* world;
+    float dt;
+    float speed; // simulated seconds per wall second; simulation thread only once started
+    double maxLag;
+    double publishInterval; // wall seconds between snapshots at most
+    double simTime;
+    void (*step)(SimThread* sim, float dt); // one fixed step
+    void (*describe)(SimThread* sim, char* text, int size); // status lines for the snapshot
+    void* user;
+    // per slot, optional: written by the simulation thread only, since a despawned slot is reused
+    // while the renderer may still draw an older snapshot that holds it
+    const Color* slotColors;
+
+    SimQueue commands; // render to simulation
+    SimQueue events; // simulation to render
+    TripleBuffer snapshots;
+    ObjectDrawDescriptor* lastDraw; // per slot: as last published
+    unsigned int* lastGeneration; // per slot: generation last published, ~0 never
+    double lastSimTime;
+    SimThreadStats stats;
+    SnapshotReaderStats readerStats;
+    pthread_t thread;
+    atomic_bool quit;
+};
+
+void SimThreadInit(SimThread* sim, World* world, float dt, void* user);
+void SimThreadFree(SimThread* sim);
+void SimThreadStart(SimThread* sim);
+// Returns once the thread has finished its current step and exited.
+void SimThreadStop(SimThread* sim);
+// Render thread; false when the queue is full.
+bool SimThreadPost(SimThread* sim, SimCommand command);
+// Simulation thread, from the step callback; false when the queue is full.
+bool SimThreadEmit(SimThread* sim, SimEvent event);
+// Render thread; false when there is nothing new.
+bool SimThreadPollEvent(SimThread* sim, SimEvent* event);
+// Render thread. The latest published snapshot, valid until the next call; never blocks.
+const Snapshot* SimThreadRead(SimThread* sim);
+// The monotonic clock snapshots are stamped with, in seconds.
+double SimThreadClock(void);
+// How far from previous to draw towards draw at wall time now, in [0, 1]. Drawing runs one
+// snapshot behind the simulation, so there is a state on either side of the time shown and motion
+// stays even however the step and frame rates line up.
+float SnapshotBlend(const Snapshot* snapshot, double now);
+// Object i of the snapshot with position and squished size interpolated by blend.
+ObjectDrawDescriptor SnapshotDraw(const Snapshot* snapshot, int i, float blend);
+
+#endif
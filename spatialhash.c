@@ -0,0 +1,183 @@
+#include "spatialhash.h"
+
+#include "math.h"
+#include "stdbool.h"
+#include "string.h"
+
+void SpatialHashInit(SpatialHash* hash, float cellSize)
+{
+    memset(hash, 0, sizeof(*hash));
+    hash->cellSize = cellSize;
+}
+
+void SpatialHashFree(SpatialHash* hash)
+{
+    free(hash->bucketStart);
+    free(hash->bodyBucket);
+    free(hash->bodies);
+    free(hash->sortedX);
+    free(hash->sortedY);
+    free(hash->sortedSizeX);
+    free(hash->sortedSizeY);
+    memset(hash, 0, sizeof(*hash));
+}
+
+// The plane is folded onto a stride x rows torus of buckets. Unlike a multiplicative hash this
+// keeps neighbouring cells in neighbouring buckets, so a 3-cell row of the probe is usually one
+// contiguous bucket range and bucket order follows space.
+static inline int Bucket(const SpatialHash* hash, int cx, int cy)
+{
+    return (cy & (hash->rows - 1)) * hash->stride + (cx & (hash->stride - 1));
+}
+
+void SpatialHashBuild(SpatialHash* hash, const float* x, const float* y, const float* sizeX, const float* sizeY, int count)
+{
+    if (count > hash->bodyCapacity) {
+        hash->bodyBucket = realloc(hash->bodyBucket, sizeof(int) * count);
+        hash->bodies = realloc(hash->bodies, sizeof(int) * count);
+        hash->sortedX = realloc(hash->sortedX, sizeof(float) * count);
+        hash->sortedY = realloc(hash->sortedY, sizeof(float) * count);
+        hash->sortedSizeX = realloc(hash->sortedSizeX, sizeof(float) * count);
+        hash->sortedSizeY = realloc(hash->sortedSizeY, sizeof(float) * count);
+        hash->bodyCapacity = count;
+    }
+    hash->cell = hash->cellSize;
+    if (hash->cell <= 0) {
+        float largest = 0;
+        for (int i = 0; i < count; i++) {
+            largest = fmaxf(largest, fmaxf(sizeX[i], sizeY[i]));
+        }
+        hash->cell = largest > 0 ? 2 * largest : 1;
+    }
+    float inverseCell = 1.0f / hash->cell;
+
+    // the torus takes the shape of the occupied cells, so a long floor full of objects does not
+    // fold a hundred columns onto each bucket
+    float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+    for (int i = 0; i < count; i++) {
+        minX = fminf(minX, x[i]);
+        maxX = fmaxf(maxX, x[i]);
+        minY = fminf(minY, y[i]);
+        maxY = fmaxf(maxY, y[i]);
+    }
+    float spanX = count > 0 ? (maxX - minX) * inverseCell + 1 : 1;
+    float spanY = count > 0 ? (maxY - minY) * inverseCell + 1 : 1;
+    hash->stride = 4;
+    hash->rows = 4;
+    while (hash->stride * hash->rows < 2 * count) {
+        if (spanY / hash->rows > spanX / hash->stride) hash->rows *= 2;
+        else hash->stride *= 2;
+    }
+    hash->bucketCount = hash->stride * hash->rows;
+    if (hash->bucketCount + 1 > hash->bucketCapacity) {
+        hash->bucketStart = realloc(hash->bucketStart, sizeof(int) * (hash->bucketCount + 1));
+        hash->bucketCapacity = hash->bucketCount + 1;
+    }
+    hash->count = count;
+
+    memset(hash->bucketStart, 0, sizeof(int) * (hash->bucketCount + 1));
+    for (int i = 0; i < count; i++) {
+        int bucket = Bucket(hash, (int)floorf(x[i] * inverseCell), (int)floorf(y[i] * inverseCell));
+        hash->bodyBucket[i] = bucket;
+        hash->bucketStart[bucket + 1] += 1;
+    }
+
+    SpatialHashStats stats = { hash->bucketCount };
+    for (int b = 0; b < hash->bucketCount; b++) {
+        int occupancy = hash->bucketStart[b + 1];
+        stats.occupied += occupancy > 0;
+        if (occupancy > stats.maxOccupancy) stats.maxOccupancy = occupancy;
+        stats.histogram[occupancy < SPATIAL_HASH_HISTOGRAM ? occupancy : SPATIAL_HASH_HISTOGRAM - 1] += 1;
+        hash->bucketStart[b + 1] += hash->bucketStart[b];
+    }
+    stats.meanOccupancy = stats.occupied ? (float)count / stats.occupied : 0;
+    hash->stats = stats;
+
+    for (int i = 0; i < count; i++) {
+        int slot = hash->bucketStart[hash->bodyBucket[i]]++;
+        hash->bodies[slot] = i;
+        hash->sortedX[slot] = x[i];
+        hash->sortedY[slot] = y[i];
+        hash->sortedSizeX[slot] = sizeX[i];
+        hash->sortedSizeY[slot] = sizeY[i];
+    }
+    for (int b = hash->bucketCount; b > 0; b--) {
+        hash->bucketStart[b] = hash->bucketStart[b - 1];
+    }
+    hash->bucketStart[0] = 0;
+}
+
+void SpatialHashFindPairs(const SpatialHash* hash, int begin, int end, PairList* pairs)
+{
+    float inverseCell = 1.0f / hash->cell;
+    for (int k = begin; k < end; k++) {
+        float xk = hash->sortedX[k];
+        float yk = hash->sortedY[k];
+        float sxk = hash->sortedSizeX[k];
+        float syk = hash->sortedSizeY[k];
+        int cx = (int)floorf(xk * inverseCell);
+        int cy = (int)floorf(yk * inverseCell);
+
+        for (int ny = cy - 1; ny <= cy + 1; ny++) {
+            // cx - 1 .. cx + 1 is one range unless it wraps around the stride
+            int left = Bucket(hash, cx - 1, ny);
+            int right = Bucket(hash, cx + 1, ny);
+            int ranges[2][2] = { { left, right }, { 0, -1 } };
+            if (right < left) {
+                ranges[0][1] = left - ((cx - 1) & (hash->stride - 1)) + hash->stride - 1;
+                ranges[1][0] = right - ((cx + 1) & (hash->stride - 1));
+                ranges[1][1] = right;
+            }
+            for (int r = 0; r < 2; r++) {
+                // every pair is seen from both sides, keep the one from the lower position
+                int first = hash->bucketStart[ranges[r][0]];
+                int last = ranges[r][1] >= ranges[r][0] ? hash->bucketStart[ranges[r][1] + 1] : first;
+                if (first <= k) first = k + 1;
+                if (first >= last) continue;
+                // candidates are written unconditionally and kept only when the boxes overlap,
+                // the overlap test is a coin flip for the branch predictor
+                PairListReserve(pairs, last - first);
+                BodyPair* out = pairs->pairs;
+                int n = pairs->count;
+                int bk = hash->bodies[k];
+                for (int o = first; o < last; o++) {
+                    bool overlap = (fabsf(hash->sortedX[o] - xk) < hash->sortedSizeX[o] + sxk)
+                        & (fabsf(hash->sortedY[o] - yk) < hash->sortedSizeY[o] + syk);
+                    int bo = hash->bodies[o];
+                    out[n].a = bk < bo ? bk : bo;
+                    out[n].b = bk < bo ? bo : bk;
+                    n += overlap;
+                }
+                pairs->count = n;
+            }
+        }
+    }
+}
+
+int SpatialHashQuery(const SpatialHash* hash, float x, float y, float sizeX, float sizeY, int* bodies, int capacity)
+{
+    if (hash->count == 0) return 0;
+    // a body of the hash reaches at most half a cell out of its own cell
+    float inverseCell = 1.0f / hash->cell;
+    float reachX = sizeX + 0.5f * hash->cell;
+    float reachY = sizeY + 0.5f * hash->cell;
+    int minX = (int)floorf((x - reachX) * inverseCell), maxX = (int)floorf((x + reachX) * inverseCell);
+    int minY = (int)floorf((y - reachY) * inverseCell), maxY = (int)floorf((y + reachY) * inverseCell);
+    // past one turn of the torus every bucket has been seen
+    if (maxX - minX >= hash->stride) maxX = minX + hash->stride - 1;
+    if (maxY - minY >= hash->rows) maxY = minY + hash->rows - 1;
+
+    int found = 0;
+    for (int cy = minY; cy <= maxY; cy++) {
+        for (int cx = minX; cx <= maxX; cx++) {
+            int bucket = Bucket(hash, cx, cy);
+            for (int o = hash->bucketStart[bucket]; o < hash->bucketStart[bucket + 1]; o++) {
+                if (fabsf(hash->sortedX[o] - x) >= hash->sortedSizeX[o] + sizeX) continue;
+                if (fabsf(hash->sortedY[o] - y) >= hash->sortedSizeY[o] + sizeY) continue;
+                if (found < capacity) bodies[found] = hash->bodies[o];
+                found += 1;
+            }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,54 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include "broadphase.h"
+
+#define SPATIAL_HASH_HISTOGRAM 8
+
+// Occupancy of the hash buckets after a build; histogram[k] counts buckets holding k bodies,
+// the last entry everything from SPATIAL_HASH_HISTOGRAM - 1 up.
+typedef struct {
+    int buckets;
+    int occupied;
+    int maxOccupancy;
+    float meanOccupancy; // over occupied buckets
+    int histogram[SPATIAL_HASH_HISTOGRAM];
+} SpatialHashStats;
+
+// Uniform grid hashed into a bucket table, for bodies of similar size. Bodies are inserted by
+// their center; the cell is at least the largest box width, so overlapping boxes always sit in
+// neighbouring cells and a 3x3 probe finds every pair. The grid is unbounded: cells far apart
+// may share a bucket and are told apart by the box test. Rebuilt with a counting sort.
+typedef struct {
+    float cellSize; // 0 picks twice the largest half extent on every build
+    float cell; // size used by the last build
+
+    int bucketCount; // stride * rows, both powers of two, at least twice the body count
+    int stride;
+    int rows;
+    int bucketCapacity;
+    int* bucketStart;
+    int bodyCapacity;
+    int* bodyBucket;
+    int* bodies; // body indices in bucket order
+    float* sortedX; // positions and half extents in bucket order
+    float* sortedY;
+    float* sortedSizeX;
+    float* sortedSizeY;
+    int count;
+
+    SpatialHashStats stats;
+} SpatialHash;
+
+void SpatialHashInit(SpatialHash* hash, float cellSize);
+void SpatialHashFree(SpatialHash* hash);
+// sizeX/sizeY are half extents, like the ellipse radii of ObjectDescriptor.size.
+void SpatialHashBuild(SpatialHash* hash, const float* x, const float* y, const float* sizeX, const float* sizeY, int count);
+// Appends every overlapping pair whose first body is at bucket order position [begin, end);
+// disjoint ranges produce disjoint pairs, so threads can split [0, count).
+void SpatialHashFindPairs(const SpatialHash* hash, int begin, int end, PairList* pairs);
+// Writes up to capacity bodies whose boxes overlap the given one and returns how many there are;
+// the box may be larger than a cell.
+int SpatialHashQuery(const SpatialHash* hash, float x, float y, float sizeX, float sizeY, int* bodies, int capacity);
+
+#endif
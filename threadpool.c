@@ -0,0 +1,259 @@
+#include "threadpool.h"
+
+#include "sched.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "unistd.h"
+
+#define THREAD_POOL_SPINS 64
+#define THREAD_POOL_MIN_GRAIN 32
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Owner only. Fails when the deque is full, the caller then runs the job itself.
+static bool DequePush(ThreadPoolDeque* deque, ThreadPoolJob job)
+{
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (b - t >= THREAD_POOL_DEQUE_CAPACITY) return false;
+    deque->jobs[b % THREAD_POOL_DEQUE_CAPACITY] = job;
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+// Owner only, LIFO end.
+static bool DequeTake(ThreadPoolDeque* deque, ThreadPoolJob* job)
+{
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return false;
+    }
+    *job = deque->jobs[b % THREAD_POOL_DEQUE_CAPACITY];
+    if (t == b) {
+        // last job: race the thieves for it
+        bool won = atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+// Any thread, FIFO end. A slot is never overwritten while it can still be stolen because
+// DequePush refuses to wrap onto it.
+static bool DequeSteal(ThreadPoolDeque* deque, ThreadPoolJob* job)
+{
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (t >= b) return false;
+    *job = deque->jobs[t % THREAD_POOL_DEQUE_CAPACITY];
+    return atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+static void WakeSleepers(ThreadPool* pool)
+{
+    if (atomic_load(&pool->sleepers) > 0) {
+        pthread_mutex_lock(&pool->mutex);
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+static bool Push(ThreadPool* pool, int worker, ThreadPoolJob job)
+{
+    if (!DequePush(&pool->workers[worker].deque, job)) return false;
+    atomic_fetch_add(&pool->queued, 1);
+    WakeSleepers(pool);
+    return true;
+}
+
+static bool FindJob(ThreadPool* pool, int worker, ThreadPoolJob* job)
+{
+    ThreadPoolWorker* self = pool->workers + worker;
+    if (DequeTake(&self->deque, job)) {
+        atomic_fetch_sub(&pool->queued, 1);
+        return true;
+    }
+    if (pool->threadCount == 1) return false;
+
+    // xorshift pick of the first victim, then sweep the rest
+    self->rng ^= self->rng << 13;
+    self->rng ^= self->rng >> 17;
+    self->rng ^= self->rng << 5;
+    int start = self->rng % pool->threadCount;
+    for (int k = 0; k < pool->threadCount; k++) {
+        int victim = (start + k) % pool->threadCount;
+        if (victim == worker) continue;
+        if (DequeSteal(&pool->workers[victim].deque, job)) {
+            atomic_fetch_sub(&pool->queued, 1);
+            self->stats.steals += 1;
+            return true;
+        }
+        self->stats.failedSteals += 1;
+    }
+    return false;
+}
+
+static void RunJob(ThreadPool* pool, int worker, ThreadPoolJob job)
+{
+    // lazy binary splitting: keep the lower half, offer the upper half to thieves
+    while (job.end - job.begin > job.grain) {
+        ThreadPoolJob upper = job;
+        upper.begin = job.begin + (job.end - job.begin) / 2;
+        atomic_fetch_add(&job.group->pending, 1);
+        if (!Push(pool, worker, upper)) {
+            atomic_fetch_sub(&job.group->pending, 1);
+            break;
+        }
+        job.end = upper.begin;
+    }
+    job.task(job.context, job.begin, job.end, worker);
+    pool->workers[worker].stats.jobs += 1;
+    atomic_fetch_sub_explicit(&job.group->pending, 1, memory_order_release);
+}
+
+static void* WorkerMain(void* arg)
+{
+    ThreadPoolWorker* self = arg;
+    ThreadPool* pool = self->pool;
+
+    while (!atomic_load(&pool->quit)) {
+        ThreadPoolJob job;
+        if (FindJob(pool, self->index, &job)) {
+            RunJob(pool, self->index, job);
+            continue;
+        }
+
+        double idleStart = Now();
+        bool found = false;
+        for (int spin = 0; spin < THREAD_POOL_SPINS && !found; spin++) {
+            sched_yield();
+            found = FindJob(pool, self->index, &job);
+        }
+        if (!found) {
+            pthread_mutex_lock(&pool->mutex);
+            atomic_fetch_add(&pool->sleepers, 1);
+            while (atomic_load(&pool->queued) == 0 && !atomic_load(&pool->quit)) {
+                pthread_cond_wait(&pool->wake, &pool->mutex);
+            }
+            atomic_fetch_sub(&pool->sleepers, 1);
+            pthread_mutex_unlock(&pool->mutex);
+        }
+        self->stats.idleSeconds += Now() - idleStart;
+        if (found) {
+            RunJob(pool, self->index, job);
+        }
+    }
+    return NULL;
+}
+
+void ThreadPoolInit(ThreadPool* pool, int threadCount)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->threadCount = threadCount < 1 ? 1 : threadCount;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    atomic_init(&pool->sleepers, 0);
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->quit, false);
+
+    size_t bytes = sizeof(ThreadPoolWorker) * pool->threadCount;
+    pool->workers = aligned_alloc(64, (bytes + 63) / 64 * 64);
+    memset(pool->workers, 0, bytes);
+    for (int i = 0; i < pool->threadCount; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pool->workers[i].rng = 0x9E3779B9u * (i + 1);
+        atomic_init(&pool->workers[i].deque.top, 0);
+        atomic_init(&pool->workers[i].deque.bottom, 0);
+    }
+    for (int i = 1; i < pool->threadCount; i++) {
+        pthread_create(&pool->workers[i].thread, NULL, WorkerMain, pool->workers + i);
+    }
+}
+
+void ThreadPoolFree(ThreadPool* pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    atomic_store(&pool->quit, true);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 1; i < pool->threadCount; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->wake);
+    free(pool->workers);
+    memset(pool, 0, sizeof(*pool));
+}
+
+void ThreadPoolSubmit(ThreadPool* pool, int worker, ThreadPoolGroup* group, ThreadPoolTask task, void* context, int count)
+{
+    if (count <= 0) return;
+    ThreadPoolJob job = { task, context, 0, count, 1, group };
+    atomic_fetch_add(&group->pending, 1);
+    if (!Push(pool, worker, job)) {
+        RunJob(pool, worker, job);
+    }
+}
+
+void ThreadPoolWait(ThreadPool* pool, int worker, ThreadPoolGroup* group)
+{
+    ThreadPoolWorker* self = pool->workers + worker;
+    while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0) {
+        ThreadPoolJob job;
+        if (FindJob(pool, worker, &job)) {
+            RunJob(pool, worker, job);
+        } else {
+            double idleStart = Now();
+            sched_yield();
+            self->stats.idleSeconds += Now() - idleStart;
+        }
+    }
+}
+
+void ThreadPoolParallelFor(ThreadPool* pool, int count, ThreadPoolTask task, void* context)
+{
+    if (pool == NULL || pool->threadCount == 1 || count <= THREAD_POOL_MIN_GRAIN) {
+        if (count > 0) task(context, 0, count, 0);
+        return;
+    }
+
+    // enough pieces for stealing to even out uneven per-object cost
+    int grain = count / (pool->threadCount * 16);
+    if (grain < THREAD_POOL_MIN_GRAIN) grain = THREAD_POOL_MIN_GRAIN;
+
+    ThreadPoolGroup group;
+    atomic_init(&group.pending, 1);
+    ThreadPoolJob root = { task, context, 0, count, grain, &group };
+    RunJob(pool, 0, root);
+    ThreadPoolWait(pool, 0, &group);
+}
+
+ThreadPoolStats ThreadPoolWorkerStats(const ThreadPool* pool, int worker)
+{
+    return pool->workers[worker].stats;
+}
+
+void ThreadPoolResetStats(ThreadPool* pool)
+{
+    for (int i = 0; i < pool->threadCount; i++) {
+        memset(&pool->workers[i].stats, 0, sizeof(ThreadPoolStats));
+    }
+}
+
+int ThreadPoolDefaultThreadCount(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
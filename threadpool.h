@@ -0,0 +1,79 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "pthread.h"
+#include "stdatomic.h"
+#include "stdbool.h"
+
+#define THREAD_POOL_DEQUE_CAPACITY 1024
+
+// Runs [begin, end) of a job on worker `worker` (0 is the thread that owns the pool).
+typedef void (*ThreadPoolTask)(void* context, int begin, int end, int worker);
+
+typedef struct ThreadPool ThreadPool;
+
+// Jobs submitted against a group are waited on together.
+typedef struct {
+    atomic_int pending;
+} ThreadPoolGroup;
+
+typedef struct {
+    ThreadPoolTask task;
+    void* context;
+    int begin;
+    int end;
+    int grain; // ranges longer than this split in half, the upper half becomes stealable
+    ThreadPoolGroup* group;
+} ThreadPoolJob;
+
+// Chase-Lev deque: the owner pushes and takes at the bottom, thieves steal from the top.
+typedef struct {
+    _Alignas(64) atomic_long top;
+    _Alignas(64) atomic_long bottom;
+    ThreadPoolJob jobs[THREAD_POOL_DEQUE_CAPACITY];
+} ThreadPoolDeque;
+
+typedef struct {
+    unsigned long long jobs;
+    unsigned long long steals;
+    unsigned long long failedSteals;
+    double idleSeconds;
+} ThreadPoolStats;
+
+typedef struct {
+    ThreadPoolDeque deque;
+    ThreadPool* pool;
+    int index;
+    unsigned int rng;
+    pthread_t thread;
+    ThreadPoolStats stats;
+} ThreadPoolWorker;
+
+// Work-stealing pool. The thread that calls ThreadPoolParallelFor/ThreadPoolWait acts as
+// worker 0 and helps with the work while it waits; only one thread may do so at a time.
+struct ThreadPool {
+    int threadCount;
+    ThreadPoolWorker* workers;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    atomic_int sleepers;
+    atomic_int queued;
+    atomic_bool quit;
+};
+
+void ThreadPoolInit(ThreadPool* pool, int threadCount);
+void ThreadPoolFree(ThreadPool* pool);
+// Runs task over [0, count) split into stealable ranges and returns when all of them are
+// done, so consecutive calls are separated by a barrier.
+void ThreadPoolParallelFor(ThreadPool* pool, int count, ThreadPoolTask task, void* context);
+// Queues task over [0, count) on worker's deque; jobs may submit more jobs from inside.
+void ThreadPoolSubmit(ThreadPool* pool, int worker, ThreadPoolGroup* group, ThreadPoolTask task, void* context, int count);
+// Runs and steals jobs until every job of the group has finished.
+void ThreadPoolWait(ThreadPool* pool, int worker, ThreadPoolGroup* group);
+
+ThreadPoolStats ThreadPoolWorkerStats(const ThreadPool* pool, int worker);
+void ThreadPoolResetStats(ThreadPool* pool);
+int ThreadPoolDefaultThreadCount(void);
+
+#endif
@@ -0,0 +1,1680 @@
+#include "world.h"
+#include "simd.h"
+#include "narrowphase.h"
+
+#include "math.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define WORLD_ALIGNMENT 64
+
+ObjectDescriptor MakeObjectDescriptor(float mass, Vector2 pos, Vector2 speed, Vector2 size, float stiffness, float energyLoss)
+{
+    ObjectDescriptor object = {0};
+    object.mass = mass;
+    object.pos = pos;
+    object.speed = speed;
+    object.size = size;
+    object.stiffness = stiffness;
+    object.energyLoss = energyLoss;
+    return object;
+}
+
+static void* AllocArray(int capacity, size_t elementSize)
+{
+    size_t bytes = capacity * elementSize;
+    bytes = (bytes + WORLD_ALIGNMENT - 1) / WORLD_ALIGNMENT * WORLD_ALIGNMENT;
+    void* array = aligned_alloc(WORLD_ALIGNMENT, bytes ? bytes : WORLD_ALIGNMENT);
+    memset(array, 0, bytes);
+    return array;
+}
+
+void WorldInit(World* world, int capacity, float width, float height)
+{
+    memset(world, 0, sizeof(*world));
+    world->capacity = capacity;
+    world->width = width;
+    world->height = height;
+
+    world->posX = AllocArray(capacity, sizeof(float));
+    world->posY = AllocArray(capacity, sizeof(float));
+    world->speedX = AllocArray(capacity, sizeof(float));
+    world->speedY = AllocArray(capacity, sizeof(float));
+    world->mass = AllocArray(capacity, sizeof(float));
+    world->sizeX = AllocArray(capacity, sizeof(float));
+    world->sizeY = AllocArray(capacity, sizeof(float));
+    world->stiffness = AllocArray(capacity, sizeof(float));
+    world->energyLoss = AllocArray(capacity, sizeof(float));
+    world->forceX = AllocArray(capacity, sizeof(float));
+    world->forceY = AllocArray(capacity, sizeof(float));
+    world->bounceX = AllocArray(capacity, sizeof(int));
+    world->bounceY = AllocArray(capacity, sizeof(int));
+    world->touchX = AllocArray(capacity, sizeof(int));
+    world->touchY = AllocArray(capacity, sizeof(int));
+    world->drawSizeX = AllocArray(capacity, sizeof(float));
+    world->drawSizeY = AllocArray(capacity, sizeof(float));
+    world->squishX = AllocArray(capacity, sizeof(float));
+    world->squishY = AllocArray(capacity, sizeof(float));
+    world->restTime = AllocArray(capacity, sizeof(float));
+
+    world->objectSlot = AllocArray(capacity, sizeof(int));
+    world->slotObject = AllocArray(capacity, sizeof(int));
+    world->slotGeneration = AllocArray(capacity, sizeof(unsigned int));
+    for (int slot = 0; slot < capacity; slot++) {
+        world->slotObject[slot] = slot + 1 < capacity ? slot + 1 : -1;
+    }
+    world->freeSlot = capacity > 0 ? 0 : -1;
+    world->scratch = AllocArray(capacity, sizeof(float));
+    world->reorderInterval = 64;
+    world->islandNext = AllocArray(capacity, sizeof(int));
+    world->islandHead = AllocArray(capacity, sizeof(int));
+    world->islandParent = AllocArray(capacity, sizeof(int));
+    world->islandFirst = AllocArray(capacity, sizeof(int));
+    world->islandRest = AllocArray(capacity, sizeof(float));
+    world->sleepSpeed = 2;
+    world->sleepTime = 0.5;
+    world->ccdThreshold = 0.5;
+    world->sweepMark = AllocArray(capacity, sizeof(int));
+    world->adaptiveTolerance = 0.05;
+    world->adaptiveDt = 1.0 / 120.0;
+    world->adaptiveMinDt = 1e-5;
+    world->adaptiveMaxDt = 1.0 / 30.0;
+    world->savedPosX = AllocArray(capacity, sizeof(float));
+    world->savedPosY = AllocArray(capacity, sizeof(float));
+    world->savedSpeedX = AllocArray(capacity, sizeof(float));
+    world->savedSpeedY = AllocArray(capacity, sizeof(float));
+    world->savedBounceX = AllocArray(capacity, sizeof(int));
+    world->savedBounceY = AllocArray(capacity, sizeof(int));
+    world->savedRestTime = AllocArray(capacity, sizeof(float));
+    world->savedBlockLevel = AllocArray(capacity, sizeof(int));
+    world->savedSleepers = AllocArray(capacity, sizeof(int));
+    world->trialPosX = AllocArray(capacity, sizeof(float));
+    world->trialPosY = AllocArray(capacity, sizeof(float));
+    world->trialSpeedX = AllocArray(capacity, sizeof(float));
+    world->trialSpeedY = AllocArray(capacity, sizeof(float));
+    world->sweepStartX = AllocArray(capacity, sizeof(float));
+    world->sweepStartY = AllocArray(capacity, sizeof(float));
+    world->blockLevels = 3;
+    world->blockAccuracy = 0.01;
+    world->blockLevel = AllocArray(capacity, sizeof(int));
+    world->blockOrder = AllocArray(capacity, sizeof(int));
+    SpatialHashInit(&world->sleepGrid, 0);
+
+    world->solver = GRAVITY_SOLVER_DIRECT;
+    world->symmetric = true;
+    BarnesHutInit(&world->barnesHut, 0.5);
+    FmmInit(&world->fmm, 6);
+    ParticleMeshInit(&world->particleMesh, 128, 128);
+    NeighborListInit(&world->neighborList, 64, 16, 4);
+    SpatialHashInit(&world->grid, 0);
+    AabbTreeInit(&world->tree, 4);
+}
+
+void WorldFree(World* world)
+{
+    free(world->posX);
+    free(world->posY);
+    free(world->speedX);
+    free(world->speedY);
+    free(world->mass);
+    free(world->sizeX);
+    free(world->sizeY);
+    free(world->stiffness);
+    free(world->energyLoss);
+    free(world->forceX);
+    free(world->forceY);
+    free(world->bounceX);
+    free(world->bounceY);
+    free(world->touchX);
+    free(world->touchY);
+    free(world->drawSizeX);
+    free(world->drawSizeY);
+    free(world->objectSlot);
+    free(world->slotObject);
+    free(world->slotGeneration);
+    free(world->scratch);
+    free(world->pairAccX);
+    free(world->pairAccY);
+    free(world->squishAccX);
+    free(world->squishAccY);
+    free(world->squishX);
+    free(world->squishY);
+    free(world->restTime);
+    free(world->islandNext);
+    free(world->islandHead);
+    free(world->islandParent);
+    free(world->islandFirst);
+    free(world->islandRest);
+    free(world->sweepMark);
+    free(world->impacts);
+    free(world->savedPosX);
+    free(world->savedPosY);
+    free(world->savedSpeedX);
+    free(world->savedSpeedY);
+    free(world->savedBounceX);
+    free(world->savedBounceY);
+    free(world->savedRestTime);
+    free(world->savedBlockLevel);
+    free(world->savedSleepers);
+    free(world->trialPosX);
+    free(world->trialPosY);
+    free(world->trialSpeedX);
+    free(world->trialSpeedY);
+    free(world->sweepStartX);
+    free(world->sweepStartY);
+    free(world->blockLevel);
+    free(world->blockOrder);
+    PairListFree(&world->sweepPairs);
+    SpatialHashFree(&world->sleepGrid);
+    BarnesHutFree(&world->barnesHut);
+    FmmFree(&world->fmm);
+    ParticleMeshFree(&world->particleMesh);
+    NeighborListFree(&world->neighborList);
+    SpatialHashFree(&world->grid);
+    AabbTreeFree(&world->tree);
+    for (int w = 0; w < world->pairListCount; w++) {
+        PairListFree(world->pairLists + w);
+        PairListFree(world->contactLists + w);
+    }
+    free(world->pairLists);
+    free(world->contactLists);
+    memset(world, 0, sizeof(*world));
+}
+
+// Moves object from into dense id to, keeping its slot pointing at it.
+static void MoveObject(World* world, int from, int to)
+{
+    world->posX[to] = world->posX[from];
+    world->posY[to] = world->posY[from];
+    world->speedX[to] = world->speedX[from];
+    world->speedY[to] = world->speedY[from];
+    world->mass[to] = world->mass[from];
+    world->sizeX[to] = world->sizeX[from];
+    world->sizeY[to] = world->sizeY[from];
+    world->stiffness[to] = world->stiffness[from];
+    world->energyLoss[to] = world->energyLoss[from];
+    world->forceX[to] = world->forceX[from];
+    world->forceY[to] = world->forceY[from];
+    world->bounceX[to] = world->bounceX[from];
+    world->bounceY[to] = world->bounceY[from];
+    world->touchX[to] = world->touchX[from];
+    world->touchY[to] = world->touchY[from];
+    world->drawSizeX[to] = world->drawSizeX[from];
+    world->drawSizeY[to] = world->drawSizeY[from];
+    world->restTime[to] = world->restTime[from];
+    world->objectSlot[to] = world->objectSlot[from];
+    world->slotObject[world->objectSlot[to]] = to;
+}
+
+static inline void Swap4(void* array, int a, int b)
+{
+    unsigned int* values = array;
+    unsigned int t = values[a];
+    values[a] = values[b];
+    values[b] = t;
+}
+
+// Exchanges two objects in every per-object array, keeping their slots pointing at them.
+static void SwapObjects(World* world, int a, int b)
+{
+    if (a == b) return;
+    Swap4(world->posX, a, b);
+    Swap4(world->posY, a, b);
+    Swap4(world->speedX, a, b);
+    Swap4(world->speedY, a, b);
+    Swap4(world->mass, a, b);
+    Swap4(world->sizeX, a, b);
+    Swap4(world->sizeY, a, b);
+    Swap4(world->stiffness, a, b);
+    Swap4(world->energyLoss, a, b);
+    Swap4(world->forceX, a, b);
+    Swap4(world->forceY, a, b);
+    Swap4(world->bounceX, a, b);
+    Swap4(world->bounceY, a, b);
+    Swap4(world->touchX, a, b);
+    Swap4(world->touchY, a, b);
+    Swap4(world->drawSizeX, a, b);
+    Swap4(world->drawSizeY, a, b);
+    Swap4(world->restTime, a, b);
+    Swap4(world->objectSlot, a, b);
+    world->slotObject[world->objectSlot[a]] = a;
+    world->slotObject[world->objectSlot[b]] = b;
+}
+
+ObjectHandle WorldSpawn(World* world, ObjectDescriptor descriptor)
+{
+    ObjectHandle handle = { -1, 0 };
+    if (world->freeSlot < 0) return handle;
+    handle.slot = world->freeSlot;
+    handle.generation = world->slotGeneration[handle.slot];
+    world->freeSlot = world->slotObject[handle.slot];
+
+    int id = world->count++;
+    if (world->awakeCount < id) {
+        // new objects are awake: the first sleeper moves to the end to make room
+        MoveObject(world, world->awakeCount, id);
+        id = world->awakeCount;
+        world->sleepGridDirty = true;
+    }
+    world->awakeCount += 1;
+    world->objectSlot[id] = handle.slot;
+    world->slotObject[handle.slot] = id;
+    world->posX[id] = descriptor.pos.x;
+    world->posY[id] = descriptor.pos.y;
+    world->speedX[id] = descriptor.speed.x;
+    world->speedY[id] = descriptor.speed.y;
+    world->mass[id] = descriptor.mass;
+    world->sizeX[id] = descriptor.size.x;
+    world->sizeY[id] = descriptor.size.y;
+    world->stiffness[id] = descriptor.stiffness;
+    world->energyLoss[id] = descriptor.energyLoss;
+    world->forceX[id] = 0;
+    world->forceY[id] = 0;
+    world->bounceX[id] = 0;
+    world->bounceY[id] = 0;
+    world->touchX[id] = 0;
+    world->touchY[id] = 0;
+    world->drawSizeX[id] = descriptor.size.x;
+    world->drawSizeY[id] = descriptor.size.y;
+    world->restTime[id] = 0;
+    // new objects start at the finest level, their forces are not known yet
+    world->blockLevel[handle.slot] = BLOCK_LEVELS_MAX;
+    world->forcesFresh = false;
+    NeighborListInvalidate(&world->neighborList);
+    return handle;
+}
+
+int WorldResolve(const World* world, ObjectHandle handle)
+{
+    if (handle.slot < 0 || handle.slot >= world->capacity) return -1;
+    if (world->slotGeneration[handle.slot] != handle.generation) return -1;
+    return world->slotObject[handle.slot];
+}
+
+bool WorldDespawn(World* world, ObjectHandle handle)
+{
+    int id = WorldResolve(world, handle);
+    if (id < 0) return false;
+    // the island loses a support, so it wakes first
+    if (id >= world->awakeCount) {
+        WorldWake(world, handle);
+        id = world->slotObject[handle.slot];
+    }
+    // the hole is filled from the end of the awake range, and that from the end of the sleepers
+    int lastAwake = --world->awakeCount;
+    if (id != lastAwake) {
+        MoveObject(world, lastAwake, id);
+    }
+    int last = --world->count;
+    if (lastAwake != last) {
+        MoveObject(world, last, lastAwake);
+        world->sleepGridDirty = true;
+    }
+    world->forcesFresh = false;
+    NeighborListInvalidate(&world->neighborList);
+    // a bumped generation invalidates every copy of the handle
+    world->slotGeneration[handle.slot] += 1;
+    world->slotObject[handle.slot] = world->freeSlot;
+    world->freeSlot = handle.slot;
+    return true;
+}
+
+void WorldWake(World* world, ObjectHandle handle)
+{
+    int id = WorldResolve(world, handle);
+    if (id < world->awakeCount) return;
+    // ids shift while the members move, slots do not
+    for (int slot = world->islandHead[handle.slot]; slot >= 0; slot = world->islandNext[slot]) {
+        SwapObjects(world, world->slotObject[slot], world->awakeCount);
+        world->restTime[world->awakeCount] = 0;
+        world->awakeCount += 1;
+    }
+    world->wakes += 1;
+    world->sleepGridDirty = true;
+    world->forcesFresh = false;
+    NeighborListInvalidate(&world->neighborList);
+}
+
+void WorldWakeAll(World* world)
+{
+    if (world->awakeCount == world->count) return;
+    for (int i = world->awakeCount; i < world->count; i++) {
+        world->restTime[i] = 0;
+    }
+    world->awakeCount = world->count;
+    world->sleepGridDirty = true;
+    world->forcesFresh = false;
+    NeighborListInvalidate(&world->neighborList);
+}
+
+typedef struct {
+    World* world;
+    float dt;
+    Vector2 extAcceleration;
+    float u;
+    float kick; // of the current ContactTask or DriftTask pass
+    float drift;
+    int first; // ContactTask runs over [first, first + count)
+    int active; // objects [0, active) need forces
+} WorldStepContext;
+
+// All-pairs sum with the semantics of the old gravity(from, to): G * mi * mj / r^2 towards j.
+static void GravityDirect(World* world, int begin, int end)
+{
+    const float G = GRAVITY_CONSTANT;
+    const float* x = world->posX;
+    const float* y = world->posY;
+    const float* mass = world->mass;
+    for (int i = begin; i < end; i++) {
+        float fx = 0, fy = 0;
+        for (int j = 0; j < world->count; j++) {
+            if (i == j) continue;
+            float dx = x[j] - x[i];
+            float dy = y[j] - y[i];
+            float radius = sqrtf(dx * dx + dy * dy);
+            float force = G * mass[j] * mass[i] / (radius * radius);
+            fx += dx / radius * force;
+            fy += dy / radius * force;
+        }
+        world->forceX[i] = fx;
+        world->forceY[i] = fy;
+    }
+}
+
+static void GravityTask(void* context, int begin, int end, int worker)
+{
+    World* world = ((WorldStepContext*)context)->world;
+    if (world->solver == GRAVITY_SOLVER_BARNES_HUT) {
+        for (int i = begin; i < end; i++) {
+            BarnesHutForce(&world->barnesHut, world->posX, world->posY, world->mass, i, world->forceX + i, world->forceY + i);
+        }
+    } else if (world->solver == GRAVITY_SOLVER_CUTOFF) {
+        for (int i = begin; i < end; i++) {
+            NeighborListForce(&world->neighborList, world->posX, world->posY, world->mass, i, world->forceX + i, world->forceY + i);
+        }
+    } else if (world->simd) {
+        SimdGravityDirect(world->posX, world->posY, world->mass, world->count, begin, end, world->forceX, world->forceY);
+    } else {
+        GravityDirect(world, begin, end);
+    }
+}
+
+static void GravityRow(World* world, int i, float* accX, float* accY)
+{
+    if (world->simd) {
+        SimdGravityRow(world->posX, world->posY, world->mass, world->count, i, accX, accY);
+        return;
+    }
+    const float* x = world->posX;
+    const float* y = world->posY;
+    const float* mass = world->mass;
+    float sumX = 0, sumY = 0;
+    for (int j = i + 1; j < world->count; j++) {
+        float dx = x[j] - x[i];
+        float dy = y[j] - y[i];
+        float r2 = dx * dx + dy * dy;
+        if (r2 <= 0) continue;
+        float inv3 = 1.0f / (r2 * sqrtf(r2));
+        sumX += dx * mass[j] * inv3;
+        sumY += dy * mass[j] * inv3;
+        accX[j] -= dx * mass[i] * inv3;
+        accY[j] -= dy * mass[i] * inv3;
+    }
+    accX[i] += sumX;
+    accY[i] += sumY;
+}
+
+// Row i and its mirror count - 1 - i together hold count - 1 pairs, so every index of this
+// loop costs the same. Each worker scatters into its own accumulators.
+static void GravityPairsTask(void* context, int begin, int end, int worker)
+{
+    World* world = ((WorldStepContext*)context)->world;
+    float* accX = world->pairAccX + (size_t)worker * world->capacity;
+    float* accY = world->pairAccY + (size_t)worker * world->capacity;
+    for (int k = begin; k < end; k++) {
+        int mirror = world->count - 1 - k;
+        GravityRow(world, k, accX, accY);
+        if (mirror != k) {
+            GravityRow(world, mirror, accX, accY);
+        }
+    }
+}
+
+// Sums the worker accumulators into forces and clears them for the next substep.
+static void GravityReduceTask(void* context, int begin, int end, int worker)
+{
+    World* world = ((WorldStepContext*)context)->world;
+    const float G = GRAVITY_CONSTANT;
+    for (int i = begin; i < end; i++) {
+        float ax = 0, ay = 0;
+        for (int w = 0; w < world->pairWorkers; w++) {
+            size_t index = (size_t)w * world->capacity + i;
+            ax += world->pairAccX[index];
+            ay += world->pairAccY[index];
+            world->pairAccX[index] = 0;
+            world->pairAccY[index] = 0;
+        }
+        world->forceX[i] = G * world->mass[i] * ax;
+        world->forceY[i] = G * world->mass[i] * ay;
+    }
+}
+
+// Per-worker accumulators for passes that scatter into other bodies, allocated once per pool
+// size and kept zeroed between uses.
+static void EnsureAccumulators(World* world)
+{
+    int workers = world->pool ? world->pool->threadCount : 1;
+    if (workers > world->pairWorkers) {
+        free(world->pairAccX);
+        free(world->pairAccY);
+        free(world->squishAccX);
+        free(world->squishAccY);
+        world->pairAccX = AllocArray(world->capacity * workers, sizeof(float));
+        world->pairAccY = AllocArray(world->capacity * workers, sizeof(float));
+        world->squishAccX = AllocArray(world->capacity * workers, sizeof(float));
+        world->squishAccY = AllocArray(world->capacity * workers, sizeof(float));
+        world->pairWorkers = workers;
+    }
+}
+
+static void GravityPairs(World* world, WorldStepContext* context)
+{
+    EnsureAccumulators(world);
+    ThreadPoolParallelFor(world->pool, (world->count + 1) / 2, GravityPairsTask, context);
+    ThreadPoolParallelFor(world->pool, world->count, GravityReduceTask, context);
+}
+
+// Long-range solvers only run with everything awake, see WorldStep.
+static void Gravity(World* world, WorldStepContext* context)
+{
+    switch (world->solver) {
+    case GRAVITY_SOLVER_BARNES_HUT:
+        // the tree is built on one thread, the walks are independent per body
+        BarnesHutBuild(&world->barnesHut, world->posX, world->posY, world->mass, world->count);
+        ThreadPoolParallelFor(world->pool, context->active, GravityTask, context);
+        break;
+    case GRAVITY_SOLVER_FMM:
+        FmmForces(&world->fmm, world->posX, world->posY, world->mass, world->count, world->forceX, world->forceY);
+        break;
+    case GRAVITY_SOLVER_P3M:
+        ParticleMeshForces(&world->particleMesh, world->width, world->height, world->posX, world->posY, world->mass, world->count, world->forceX, world->forceY);
+        break;
+    case GRAVITY_SOLVER_CUTOFF:
+        // serial staleness check of the awake bodies, the rare rebuild, then independent per-body
+        // sums; sleepers stay in the list as sources
+        NeighborListUpdateMoving(&world->neighborList, world->posX, world->posY, world->count, world->awakeCount);
+        ThreadPoolParallelFor(world->pool, context->active, GravityTask, context);
+        break;
+    default:
+        // the pairs give every body its force, which only pays off when every body is due
+        if (world->symmetric && context->active == world->awakeCount) {
+            GravityPairs(world, context);
+        } else {
+            ThreadPoolParallelFor(world->pool, context->active, GravityTask, context);
+        }
+        break;
+    }
+}
+
+// Wall force for depth y (signed, along the normal) and speed v, with force the rest of what acts
+// along that axis. Implicit: the speed after the step solves v' = v + dt / m * (force - k * (y + dt
+// * v') - c * v'), and the returned force is the one that yields it.
+static inline float WallNormal(bool implicit, float y, float v, float force, float mass, float k, float c, float dt)
+{
+    if (implicit) {
+        float stepPerMass = dt / mass;
+        v = (v + stepPerMass * (force - k * y)) / (1 + stepPerMass * c + stepPerMass * dt * k);
+        y += dt * v;
+    }
+    return -k * y - c * v;
+}
+
+// Mass-spring-damper contact against the four walls, then a kick of the speed and a drift of the
+// position with the new speed; kick and drift of one dt are a semi-implicit Euler step.
+static inline void MakeObjectDrawDescriptor(World* world, int i, float kick, float drift, Vector2 extAcceleration, float u)
+{
+    float sizeX = world->sizeX[i];
+    float sizeY = world->sizeY[i];
+    float area = PI * sizeX * sizeY;
+    float posX = world->posX[i];
+    float posY = world->posY[i];
+    float speedX = world->speedX[i];
+    float speedY = world->speedY[i];
+    float mass = world->mass[i];
+    float k = world->stiffness[i];
+    float c = world->energyLoss[i];
+
+    float forceX = extAcceleration.x * mass + world->forceX[i];
+    float forceY = extAcceleration.y * mass + world->forceY[i];
+    float frictionX = 0, frictionY = 0;
+
+    float y = fminf(posY - sizeY, 0.0) + fmaxf(posY + sizeY - world->height, 0.0);
+    if (fabsf(y) > 0) {
+        world->touchY[i] = 1;
+        float N = WallNormal(world->implicitContact, y, speedY, forceY, mass, k, c, kick);
+        forceY += N;
+        sizeY -= fabsf(y);
+        sizeX = area / (sizeY * PI);
+
+        // at rest there is no direction to oppose
+        frictionX = -(float)((speedX > 0) - (speedX < 0)) * u * N;
+    }
+
+    float x = fminf(posX - sizeX, 0.0) + fmaxf(posX + sizeX - world->width, 0.0);
+    if (fabsf(x) > 0) {
+        world->touchX[i] = 1;
+        float N = WallNormal(world->implicitContact, x, speedX, forceX, mass, k, c, kick);
+        forceX += N;
+        sizeX -= fabsf(x);
+        sizeY = area / (sizeX * PI);
+
+        frictionY = (float)((speedY > 0) - (speedY < 0)) * u * N;
+    }
+
+    forceX += frictionX;
+    forceY += frictionY;
+
+    world->drawSizeX[i] = sizeX;
+    world->drawSizeY[i] = sizeY;
+
+    if (fabsf(speedY) < 0.1 && fabsf(speedX) < 0.1 && fabsf(forceY) < 0.1 && fabsf(forceX) < 0.1) {
+        return;
+    }
+
+    speedX += forceX / mass * kick;
+    speedY += forceY / mass * kick;
+    world->speedX[i] = speedX;
+    world->speedY[i] = speedY;
+    world->posX[i] = posX + speedX * drift;
+    world->posY[i] = posY + speedY * drift;
+}
+
+void WorldContactIntegrate(World* world, int begin, int end, float kick, float drift, Vector2 extAcceleration, float u)
+{
+    for (int i = begin; i < end; i++) {
+        MakeObjectDrawDescriptor(world, i, kick, drift, extAcceleration, u);
+    }
+}
+
+// Shrinks the drawn ellipse by what other objects pressed into it, keeping the area like the
+// wall squish does. At most half of each axis goes.
+static void ApplySquish(World* world, int begin, int end)
+{
+    for (int i = begin; i < end; i++) {
+        float sizeX = world->drawSizeX[i];
+        float sizeY = world->drawSizeY[i];
+        if (world->squishX[i] > 0) {
+            float squished = fmaxf(sizeX - world->squishX[i], 0.5f * sizeX);
+            sizeY *= sizeX / squished;
+            sizeX = squished;
+        }
+        if (world->squishY[i] > 0) {
+            float squished = fmaxf(sizeY - world->squishY[i], 0.5f * sizeY);
+            sizeX *= sizeY / squished;
+            sizeY = squished;
+        }
+        world->drawSizeX[i] = sizeX;
+        world->drawSizeY[i] = sizeY;
+    }
+}
+
+static void ContactTask(void* context, int begin, int end, int worker)
+{
+    WorldStepContext* step = context;
+    begin += step->first;
+    end += step->first;
+    if (step->world->simd) {
+        SimdContactIntegrate(step->world, begin, end, step->kick, step->drift, step->extAcceleration, step->u);
+    } else {
+        WorldContactIntegrate(step->world, begin, end, step->kick, step->drift, step->extAcceleration, step->u);
+    }
+    if (step->world->collisions) {
+        ApplySquish(step->world, begin, end);
+    }
+}
+
+// New id k takes old id order[k]. Gathers into the scratch array and swaps it in, the old
+// array becomes the next scratch. Every per-object array holds 4-byte elements. Sleepers past
+// count stay where they are, so then the gathered values are copied back instead.
+static void Permute(void** array, void** scratch, const int* order, int count, int total)
+{
+    unsigned int* from = *array;
+    unsigned int* to = *scratch;
+    for (int k = 0; k < count; k++) {
+        to[k] = from[order[k]];
+    }
+    if (count < total) {
+        memcpy(from, to, sizeof(unsigned int) * count);
+        return;
+    }
+    *scratch = *array;
+    *array = to;
+}
+
+// New awake id k takes old id order[k].
+static void ReorderObjects(World* world, const int* order)
+{
+    int count = world->awakeCount;
+    int total = world->count;
+    Permute((void**)&world->posX, &world->scratch, order, count, total);
+    Permute((void**)&world->posY, &world->scratch, order, count, total);
+    Permute((void**)&world->speedX, &world->scratch, order, count, total);
+    Permute((void**)&world->speedY, &world->scratch, order, count, total);
+    Permute((void**)&world->mass, &world->scratch, order, count, total);
+    Permute((void**)&world->sizeX, &world->scratch, order, count, total);
+    Permute((void**)&world->sizeY, &world->scratch, order, count, total);
+    Permute((void**)&world->stiffness, &world->scratch, order, count, total);
+    Permute((void**)&world->energyLoss, &world->scratch, order, count, total);
+    Permute((void**)&world->forceX, &world->scratch, order, count, total);
+    Permute((void**)&world->forceY, &world->scratch, order, count, total);
+    Permute((void**)&world->bounceX, &world->scratch, order, count, total);
+    Permute((void**)&world->bounceY, &world->scratch, order, count, total);
+    Permute((void**)&world->touchX, &world->scratch, order, count, total);
+    Permute((void**)&world->touchY, &world->scratch, order, count, total);
+    Permute((void**)&world->drawSizeX, &world->scratch, order, count, total);
+    Permute((void**)&world->drawSizeY, &world->scratch, order, count, total);
+    Permute((void**)&world->restTime, &world->scratch, order, count, total);
+    Permute((void**)&world->objectSlot, &world->scratch, order, count, total);
+    for (int k = 0; k < count; k++) {
+        world->slotObject[world->objectSlot[k]] = k;
+    }
+    NeighborListInvalidate(&world->neighborList);
+}
+
+// Puts the awake objects in the grid's bucket order so that nearby objects are nearby in memory,
+// and relabels the grid to match.
+static void ReorderByGrid(World* world)
+{
+    ReorderObjects(world, world->grid.bodies);
+    for (int k = 0; k < world->awakeCount; k++) {
+        world->grid.bodies[k] = k;
+    }
+}
+
+static void FindPairsTask(void* context, int begin, int end, int worker)
+{
+    World* world = context;
+    if (world->broadphase == BROADPHASE_TREE) {
+        AabbTreeFindPairs(&world->tree, world->posX, world->posY, world->sizeX, world->sizeY, world->slotObject, begin, end, world->pairLists + worker);
+    } else {
+        SpatialHashFindPairs(&world->grid, begin, end, world->pairLists + worker);
+    }
+}
+
+void WorldFindPairs(World* world)
+{
+    int workers = world->pool ? world->pool->threadCount : 1;
+    if (workers > world->pairListCount) {
+        world->pairLists = realloc(world->pairLists, sizeof(PairList) * workers);
+        world->contactLists = realloc(world->contactLists, sizeof(PairList) * workers);
+        memset(world->pairLists + world->pairListCount, 0, sizeof(PairList) * (workers - world->pairListCount));
+        memset(world->contactLists + world->pairListCount, 0, sizeof(PairList) * (workers - world->pairListCount));
+        world->pairListCount = workers;
+    }
+    for (int w = 0; w < world->pairListCount; w++) {
+        world->pairLists[w].count = 0;
+    }
+    if (world->broadphase == BROADPHASE_TREE) {
+        // incremental: only bodies that left their fat box touch the tree
+        // sleepers drop out of the tree and come back in when they wake
+        AabbTreeUpdate(&world->tree, world->posX, world->posY, world->sizeX, world->sizeY, world->objectSlot, world->awakeCount);
+        AabbTreePrepareTasks(&world->tree, workers * 16);
+        ThreadPoolParallelFor(world->pool, world->tree.taskCount, FindPairsTask, world);
+    } else {
+        SpatialHashBuild(&world->grid, world->posX, world->posY, world->sizeX, world->sizeY, world->awakeCount);
+        // block steps keep the objects sorted by level instead
+        if (world->reorderInterval > 0 && !world->blockSteps && world->reorderCountdown <= 0) {
+            ReorderByGrid(world);
+            world->reorderCountdown = world->reorderInterval;
+        }
+        ThreadPoolParallelFor(world->pool, world->awakeCount, FindPairsTask, world);
+    }
+}
+
+#define OBJECT_CONTACT_BATCH 64
+
+// The wall model between two objects, N = k * y + c * closing speed, with the depth and normal
+// from the ellipse narrowphase on the rest sizes and the two objects' springs and dampers in
+// series. Pairs are spread over the pool; every worker scatters into its own accumulators.
+static void ObjectContactTask(void* context, int begin, int end, int worker)
+{
+    World* world = ((WorldStepContext*)context)->world;
+    float* accX = world->pairAccX + (size_t)worker * world->capacity;
+    float* accY = world->pairAccY + (size_t)worker * world->capacity;
+    float* squishX = world->squishAccX + (size_t)worker * world->capacity;
+    float* squishY = world->squishAccY + (size_t)worker * world->capacity;
+    EllipseContact contacts[OBJECT_CONTACT_BATCH];
+
+    int list = 0, offset = 0;
+    for (int p = begin; p < end;) {
+        while (p - offset >= world->pairLists[list].count) {
+            offset += world->pairLists[list].count;
+            list += 1;
+        }
+        // a batch never crosses from one worker's list into the next
+        int batch = world->pairLists[list].count - (p - offset);
+        batch = batch < end - p ? batch : end - p;
+        batch = batch < OBJECT_CONTACT_BATCH ? batch : OBJECT_CONTACT_BATCH;
+        const BodyPair* pairs = world->pairLists[list].pairs + (p - offset);
+        EllipseContacts(world->posX, world->posY, world->sizeX, world->sizeY, pairs, batch, contacts);
+        p += batch;
+
+        for (int q = 0; q < batch; q++) {
+            int i = pairs[q].a, j = pairs[q].b;
+            float depth = contacts[q].depth;
+            float nx = contacts[q].normalX, ny = contacts[q].normalY;
+            float ki = world->stiffness[i], kj = world->stiffness[j];
+            if (depth <= 0) continue;
+            if (world->sleeping) {
+                PairListPush(world->contactLists + worker, i, j);
+            }
+            if (ki + kj <= 0) continue;
+
+            float ci = world->energyLoss[i], cj = world->energyLoss[j];
+            float k = ki * kj / (ki + kj);
+            float c = ci + cj > 0 ? ci * cj / (ci + cj) : 0;
+            float closing = (world->speedX[i] - world->speedX[j]) * nx + (world->speedY[i] - world->speedY[j]) * ny;
+            // unlike the walls, objects only push: a damper pulling them back together makes piles sticky
+            float N = fmaxf(k * depth + c * closing, 0);
+            accX[i] -= N * nx;
+            accY[i] -= N * ny;
+            accX[j] += N * nx;
+            accY[j] += N * ny;
+
+            // each object gives way in proportion to the other's stiffness
+            float shareI = depth * kj / (ki + kj);
+            float shareJ = depth - shareI;
+            squishX[i] += shareI * fabsf(nx);
+            squishY[i] += shareI * fabsf(ny);
+            squishX[j] += shareJ * fabsf(nx);
+            squishY[j] += shareJ * fabsf(ny);
+        }
+    }
+}
+
+// Adds the worker accumulators onto the gravity forces and clears them.
+static void ObjectContactReduceTask(void* context, int begin, int end, int worker)
+{
+    World* world = ((WorldStepContext*)context)->world;
+    for (int i = begin; i < end; i++) {
+        float fx = 0, fy = 0, sx = 0, sy = 0;
+        for (int w = 0; w < world->pairWorkers; w++) {
+            size_t index = (size_t)w * world->capacity + i;
+            fx += world->pairAccX[index];
+            fy += world->pairAccY[index];
+            sx += world->squishAccX[index];
+            sy += world->squishAccY[index];
+            world->pairAccX[index] = 0;
+            world->pairAccY[index] = 0;
+            world->squishAccX[index] = 0;
+            world->squishAccY[index] = 0;
+        }
+        world->forceX[i] += fx;
+        world->forceY[i] += fy;
+        world->squishX[i] = sx;
+        world->squishY[i] = sy;
+    }
+}
+
+#define WAKE_QUERY 64
+
+// True when ccd is on and object i moves more than ccdThreshold of its smaller half axis, either
+// within the substep or in the time its spring, sqrt(m / k), takes to stop it.
+static inline bool Fast(const World* world, int i, float dt)
+{
+    if (!world->ccd) return false;
+    float reach = world->ccdThreshold * fminf(world->sizeX[i], world->sizeY[i]);
+    float time = fmaxf(dt, sqrtf(world->mass[i] / world->stiffness[i]));
+    float speed2 = world->speedX[i] * world->speedX[i] + world->speedY[i] * world->speedY[i];
+    return speed2 * time * time > reach * reach;
+}
+
+// The box object i covers over the substep: its own box when it is slow, otherwise stretched
+// along the motion. Returns whether it was stretched.
+static bool SweptBox(const World* world, int i, float dt, float* x, float* y, float* sizeX, float* sizeY)
+{
+    *x = world->posX[i];
+    *y = world->posY[i];
+    *sizeX = world->sizeX[i];
+    *sizeY = world->sizeY[i];
+    if (!Fast(world, i, dt)) return false;
+    float moveX = world->speedX[i] * dt, moveY = world->speedY[i] * dt;
+    *x += 0.5f * moveX;
+    *y += 0.5f * moveY;
+    *sizeX += 0.5f * fabsf(moveX);
+    *sizeY += 0.5f * fabsf(moveY);
+    return true;
+}
+
+// Wakes every sleeping island an awake object has run into; returns true when any woke. The
+// sleepers' own grid is queried with each awake object, so the cost follows the awake count.
+static bool WakeTouched(World* world, float dt)
+{
+    int awake = world->awakeCount;
+    if (world->sleepGridDirty) {
+        SpatialHashBuild(&world->sleepGrid, world->posX + awake, world->posY + awake, world->sizeX + awake, world->sizeY + awake, world->count - awake);
+        world->sleepGridDirty = false;
+    }
+    // slots first, waking moves ids around
+    int* touched = world->islandFirst;
+    int touchedCount = 0;
+    int found[WAKE_QUERY];
+    for (int i = 0; i < awake; i++) {
+        float x, y, sizeX, sizeY;
+        bool swept = SweptBox(world, i, dt, &x, &y, &sizeX, &sizeY);
+        int n = SpatialHashQuery(&world->sleepGrid, x, y, sizeX, sizeY, found, WAKE_QUERY);
+        // anything past the buffer is caught by the next round
+        n = n < WAKE_QUERY ? n : WAKE_QUERY;
+        for (int k = 0; k < n; k++) {
+            int j = awake + found[k];
+            // a fast object wakes whatever lies along its path
+            if (swept) {
+                if (touchedCount < world->capacity) touched[touchedCount++] = world->objectSlot[j];
+                continue;
+            }
+            EllipseContact contact = EllipseEllipseContact(world->posX[i], world->posY[i], world->sizeX[i], world->sizeY[i],
+                world->posX[j], world->posY[j], world->sizeX[j], world->sizeY[j]);
+            if (contact.depth > 0 && touchedCount < world->capacity) {
+                touched[touchedCount++] = world->objectSlot[j];
+            }
+        }
+    }
+    int woken = world->wakes;
+    for (int t = 0; t < touchedCount; t++) {
+        ObjectHandle handle = { touched[t], world->slotGeneration[touched[t]] };
+        WorldWake(world, handle);
+    }
+    return world->wakes != woken;
+}
+
+#define SWEEP_QUERY 64
+
+// Candidates of the fast objects: the broadphase is queried with their swept boxes, so the grid
+// and tree themselves keep the plain boxes and their cell size.
+static void GatherSweepPairs(World* world, float dt)
+{
+    world->sweepPairs.count = 0;
+    int found[SWEEP_QUERY];
+    for (int i = 0; i < world->awakeCount; i++) {
+        float x, y, sizeX, sizeY;
+        if (!SweptBox(world, i, dt, &x, &y, &sizeX, &sizeY)) continue;
+        int n;
+        if (world->broadphase == BROADPHASE_TREE) {
+            Aabb box = { x - sizeX, y - sizeY, x + sizeX, y + sizeY };
+            n = AabbTreeQuery(&world->tree, box, found, SWEEP_QUERY);
+        } else {
+            n = SpatialHashQuery(&world->grid, x, y, sizeX, sizeY, found, SWEEP_QUERY);
+        }
+        n = n < SWEEP_QUERY ? n : SWEEP_QUERY;
+        for (int k = 0; k < n; k++) {
+            int j = world->broadphase == BROADPHASE_TREE ? world->slotObject[found[k]] : found[k];
+            if (j != i) PairListPush(&world->sweepPairs, i, j);
+        }
+    }
+}
+
+// Broadphase pairs of the awake objects, after waking whatever they touch.
+static void ObjectPairs(World* world, float dt)
+{
+    WorldFindPairs(world);
+    while (world->awakeCount < world->count && WakeTouched(world, dt)) {
+        WorldFindPairs(world);
+    }
+    if (world->ccd) {
+        GatherSweepPairs(world, dt);
+    }
+}
+
+static void ObjectContact(World* world, WorldStepContext* context)
+{
+    EnsureAccumulators(world);
+    int pairs = 0;
+    for (int w = 0; w < world->pairListCount; w++) {
+        pairs += world->pairLists[w].count;
+        world->contactLists[w].count = 0;
+    }
+    ThreadPoolParallelFor(world->pool, pairs, ObjectContactTask, context);
+    ThreadPoolParallelFor(world->pool, world->awakeCount, ObjectContactReduceTask, context);
+}
+
+// Closed-form rebound of a mass on a spring and damper, e = exp(-pi zeta / sqrt(1 - zeta^2))
+// with the damping ratio zeta = c / (2 sqrt(k m)); overdamped contacts do not bounce.
+static float Restitution(float k, float c, float mass)
+{
+    float zeta = c / (2 * sqrtf(k * mass));
+    if (zeta >= 1) return 0;
+    return expf(-PI * zeta / sqrtf(1 - zeta * zeta));
+}
+
+static int CompareImpacts(const void* a, const void* b)
+{
+    float ta = ((const Impact*)a)->time, tb = ((const Impact*)b)->time;
+    return (ta > tb) - (ta < tb);
+}
+
+// When an object moving from start by move first reaches a wall, as a fraction of the substep;
+// 0 when it already touches the wall it moves into, INFINITY when it stays clear.
+static float WallImpact(const World* world, int i, float startX, float startY, float moveX, float moveY, bool* alongX)
+{
+    float sizeX = world->sizeX[i], sizeY = world->sizeY[i];
+    float gapX = moveX < 0 ? startX - sizeX : world->width - startX - sizeX;
+    float gapY = moveY < 0 ? startY - sizeY : world->height - startY - sizeY;
+    float tX = fabsf(moveX) > gapX ? fmaxf(gapX, 0) / fabsf(moveX) : INFINITY;
+    float tY = fabsf(moveY) > gapY ? fmaxf(gapY, 0) / fabsf(moveY) : INFINITY;
+    *alongX = tX <= tY;
+    return fminf(tX, tY);
+}
+
+// Runs after integration, from the sweepStartX/Y SweepStart kept to where the integrator left every
+// object. Fast pairs are swept as bounding circles and the earliest impacts go first:
+// both objects stop at the contact and exchange the impulse of the series spring and damper.
+// An object stops at most once per substep, and an impact behind a wall is left to the walls.
+static void SweepPairs(World* world, float dt)
+{
+    int count = 0;
+    for (int p = 0; p < world->sweepPairs.count; p++) {
+        int i = world->sweepPairs.pairs[p].a, j = world->sweepPairs.pairs[p].b;
+        float* startX = world->sweepStartX;
+        float* startY = world->sweepStartY;
+        float dx = startX[j] - startX[i];
+        float dy = startY[j] - startY[i];
+        float moveX = (world->posX[j] - startX[j]) - (world->posX[i] - startX[i]);
+        float moveY = (world->posY[j] - startY[j]) - (world->posY[i] - startY[i]);
+        float radius = fmaxf(world->sizeX[i], world->sizeY[i]) + fmaxf(world->sizeX[j], world->sizeY[j]);
+        float a = moveX * moveX + moveY * moveY;
+        float b = dx * moveX + dy * moveY;
+        float c = dx * dx + dy * dy - radius * radius;
+        if (b >= 0) continue;
+        // touching at the start and closing faster than the springs can take: bounce right away
+        float t = 0;
+        if (c > 0) {
+            float discriminant = b * b - a * c;
+            if (discriminant < 0) continue;
+            t = (-b - sqrtf(discriminant)) / a;
+            if (t > 1) continue;
+        }
+        if (count == world->impactCapacity) {
+            world->impactCapacity = world->impactCapacity ? 2 * world->impactCapacity : 64;
+            world->impacts = realloc(world->impacts, sizeof(Impact) * world->impactCapacity);
+        }
+        world->impacts[count++] = (Impact) { t, i, j };
+    }
+    if (count == 0) return;
+    qsort(world->impacts, count, sizeof(Impact), CompareImpacts);
+
+    int epoch = world->sweepEpoch;
+    for (int n = 0; n < count; n++) {
+        float t = world->impacts[n].time;
+        int i = world->impacts[n].a, j = world->impacts[n].b;
+        if (world->sweepMark[i] == epoch || world->sweepMark[j] == epoch) continue;
+        float ki = world->stiffness[i], kj = world->stiffness[j];
+        if (ki + kj <= 0) continue;
+
+        float xi = world->sweepStartX[i], yi = world->sweepStartY[i];
+        float xj = world->sweepStartX[j], yj = world->sweepStartY[j];
+        float moveXi = world->posX[i] - xi, moveYi = world->posY[i] - yi;
+        float moveXj = world->posX[j] - xj, moveYj = world->posY[j] - yj;
+        bool alongX;
+        if (WallImpact(world, i, xi, yi, moveXi, moveYi, &alongX) < t) continue;
+        if (WallImpact(world, j, xj, yj, moveXj, moveYj, &alongX) < t) continue;
+        xi += moveXi * t;
+        yi += moveYi * t;
+        xj += moveXj * t;
+        yj += moveYj * t;
+        float distance = sqrtf((xj - xi) * (xj - xi) + (yj - yi) * (yj - yi));
+        if (distance <= 0) continue;
+        float nx = (xj - xi) / distance, ny = (yj - yi) / distance;
+        float closing = (world->speedX[i] - world->speedX[j]) * nx + (world->speedY[i] - world->speedY[j]) * ny;
+        if (closing <= 0) continue;
+
+        float ci = world->energyLoss[i], cj = world->energyLoss[j];
+        float k = ki * kj / (ki + kj);
+        float c = ci + cj > 0 ? ci * cj / (ci + cj) : 0;
+        float mi = world->mass[i], mj = world->mass[j];
+        float reduced = mi * mj / (mi + mj);
+        float impulse = (1 + Restitution(k, c, reduced)) * reduced * closing;
+        world->speedX[i] -= impulse / mi * nx;
+        world->speedY[i] -= impulse / mi * ny;
+        world->speedX[j] += impulse / mj * nx;
+        world->speedY[j] += impulse / mj * ny;
+        world->posX[i] = xi;
+        world->posY[i] = yi;
+        world->posX[j] = xj;
+        world->posY[j] = yj;
+        world->sweepMark[i] = epoch;
+        world->sweepMark[j] = epoch;
+        world->sweeps += 1;
+    }
+}
+
+// The same for the walls: a fast object that reached a wall stops at the contact, or where it
+// started when it was already touching, and its normal speed flips with the restitution of its
+// spring and damper. Wall friction only acts through the penalty contact.
+static void SweepWallsTask(void* context, int begin, int end, int worker)
+{
+    WorldStepContext* step = context;
+    World* world = step->world;
+    float dt = step->dt;
+    for (int i = begin; i < end; i++) {
+        if (world->sweepMark[i] == world->sweepEpoch || !Fast(world, i, dt)) continue;
+        if (world->stiffness[i] <= 0) continue;
+        float startX = world->sweepStartX[i], startY = world->sweepStartY[i];
+        float moveX = world->posX[i] - startX, moveY = world->posY[i] - startY;
+        bool alongX;
+        float t = WallImpact(world, i, startX, startY, moveX, moveY, &alongX);
+        if (t > 1) continue;
+
+        float e = Restitution(world->stiffness[i], world->energyLoss[i], world->mass[i]);
+        // a new wall contact this step, so callers still hear the bounce
+        if (alongX) {
+            world->speedX[i] *= -e;
+            world->bounceX[i] = 0;
+            world->touchX[i] = 1;
+        } else {
+            world->speedY[i] *= -e;
+            world->bounceY[i] = 0;
+            world->touchY[i] = 1;
+        }
+        world->posX[i] = startX + moveX * t;
+        world->posY[i] = startY + moveY * t;
+    }
+}
+
+// Where every awake object starts the step; the sweep follows the straight line from there to
+// where the integrator left it, whatever the scheme did in between.
+static void SweepStart(World* world)
+{
+    for (int i = 0; i < world->awakeCount; i++) {
+        world->sweepStartX[i] = world->posX[i];
+        world->sweepStartY[i] = world->posY[i];
+    }
+}
+
+static void Sweep(World* world, WorldStepContext* context)
+{
+    world->sweepEpoch += 1;
+    // stopped objects are no longer where their forces were evaluated
+    world->forcesFresh = false;
+    if (world->collisions) {
+        SweepPairs(world, context->dt);
+    }
+    ThreadPoolParallelFor(world->pool, world->awakeCount, SweepWallsTask, context);
+}
+
+static int IslandRoot(int* parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static void IslandUnion(int* parent, int a, int b)
+{
+    a = IslandRoot(parent, a);
+    b = IslandRoot(parent, b);
+    // the lower id becomes the root so the result does not depend on pair order
+    if (a < b) parent[b] = a;
+    else parent[a] = b;
+}
+
+// Union-find over the awake objects linked by touching and by cutoff gravity, then every island
+// whose members all rested for sleepTime moves past the awake range as one slot list.
+static void UpdateIslands(World* world, float dt)
+{
+    int awake = world->awakeCount;
+    int* parent = world->islandParent;
+    float limit = world->sleepSpeed * world->sleepSpeed;
+    for (int i = 0; i < awake; i++) {
+        parent[i] = i;
+        float speed2 = world->speedX[i] * world->speedX[i] + world->speedY[i] * world->speedY[i];
+        world->restTime[i] = speed2 < limit ? world->restTime[i] + dt : 0;
+    }
+    for (int w = 0; w < world->pairListCount && world->collisions; w++) {
+        for (int p = 0; p < world->contactLists[w].count; p++) {
+            IslandUnion(parent, world->contactLists[w].pairs[p].a, world->contactLists[w].pairs[p].b);
+        }
+    }
+
+    const NeighborList* nl = &world->neighborList;
+    if (world->solver == GRAVITY_SOLVER_CUTOFF && nl->cutoff > 0) {
+        // the list was built this substep, unless ids moved since
+        if (nl->count != world->count) return;
+        float cutoff2 = nl->cutoff * nl->cutoff;
+        int* touched = world->islandFirst;
+        int touchedCount = 0;
+        for (int i = 0; i < awake; i++) {
+            for (int k = nl->start[i]; k < nl->start[i + 1]; k++) {
+                int j = nl->neighbors[k];
+                float dx = world->posX[j] - world->posX[i];
+                float dy = world->posY[j] - world->posY[i];
+                if (dx * dx + dy * dy >= cutoff2) continue;
+                if (j < awake) {
+                    IslandUnion(parent, i, j);
+                } else if (touchedCount < world->capacity) {
+                    touched[touchedCount++] = world->objectSlot[j];
+                }
+            }
+        }
+        // a sleeper that came into range wakes, and nothing falls asleep this substep
+        if (touchedCount > 0) {
+            for (int t = 0; t < touchedCount; t++) {
+                ObjectHandle handle = { touched[t], world->slotGeneration[touched[t]] };
+                WorldWake(world, handle);
+            }
+            return;
+        }
+    } else if (world->solver != GRAVITY_SOLVER_CUTOFF) {
+        // every object pulls on every other
+        for (int i = 1; i < awake; i++) {
+            parent[i] = 0;
+        }
+    }
+
+    float* rest = world->islandRest;
+    int* first = world->islandFirst;
+    for (int i = 0; i < awake; i++) {
+        rest[i] = INFINITY;
+        first[i] = -1;
+    }
+    world->islandCount = 0;
+    for (int i = 0; i < awake; i++) {
+        int root = IslandRoot(parent, i);
+        parent[i] = root;
+        rest[root] = fminf(rest[root], world->restTime[i]);
+        world->islandCount += root == i;
+    }
+    int sleepers = 0;
+    for (int i = 0; i < awake; i++) {
+        if (rest[parent[i]] < world->sleepTime) continue;
+        int slot = world->objectSlot[i];
+        world->islandNext[slot] = first[parent[i]];
+        first[parent[i]] = slot;
+        sleepers += 1;
+    }
+    if (sleepers == 0) return;
+
+    // the slots of the falling islands go to the top of scratch before ids start to move
+    int* slots = world->scratch;
+    int n = 0;
+    for (int i = 0; i < awake; i++) {
+        if (rest[parent[i]] < world->sleepTime) continue;
+        world->islandHead[world->objectSlot[i]] = first[parent[i]];
+        slots[n++] = world->objectSlot[i];
+    }
+    for (int k = 0; k < n; k++) {
+        int last = --world->awakeCount;
+        SwapObjects(world, world->slotObject[slots[k]], last);
+        world->speedX[last] = 0;
+        world->speedY[last] = 0;
+        world->forceX[last] = 0;
+        world->forceY[last] = 0;
+    }
+    world->sleepGridDirty = true;
+    NeighborListInvalidate(&world->neighborList);
+}
+
+static void DriftTask(void* context, int begin, int end, int worker)
+{
+    WorldStepContext* step = context;
+    World* world = step->world;
+    float drift = step->drift;
+    for (int i = begin; i < end; i++) {
+        world->posX[i] += world->speedX[i] * drift;
+        world->posY[i] += world->speedY[i] * drift;
+    }
+}
+
+// The force callback every integrator shares.
+static void Forces(World* world, WorldStepContext* context)
+{
+    // every body reads all positions while gathering gravity, so nobody may move
+    // before the whole gather is done; ParallelFor returning is that barrier
+    Gravity(world, context);
+    if (world->collisions) {
+        ObjectContact(world, context);
+    }
+    world->forceEvaluations += 1;
+    // contact damping reads speeds that the next kick changes, gravity only positions
+    world->forcesFresh = !world->collisions;
+}
+
+static void KickDrift(World* world, WorldStepContext* context, float kick, float drift)
+{
+    context->kick = kick;
+    context->drift = drift;
+    ThreadPoolParallelFor(world->pool, world->awakeCount, ContactTask, context);
+    world->forcesFresh = world->forcesFresh && drift == 0;
+}
+
+static void Drift(World* world, WorldStepContext* context, float drift)
+{
+    context->drift = drift;
+    ThreadPoolParallelFor(world->pool, world->awakeCount, DriftTask, context);
+    world->forcesFresh = false;
+}
+
+static void Integrate(World* world, WorldStepContext* context)
+{
+    float dt = context->dt;
+    switch (world->integrator) {
+    case INTEGRATOR_LEAPFROG:
+        Drift(world, context, 0.5f * dt);
+        Forces(world, context);
+        KickDrift(world, context, dt, 0.5f * dt);
+        break;
+    case INTEGRATOR_VERLET:
+        // the forces at the end of the last step are the ones at the start of this one
+        if (!world->forcesFresh) {
+            Forces(world, context);
+        }
+        KickDrift(world, context, 0.5f * dt, dt);
+        Forces(world, context);
+        KickDrift(world, context, 0.5f * dt, 0);
+        break;
+    case INTEGRATOR_YOSHIDA4: {
+        // w1 + w0 + w1 = 1 with a negative middle step cancels the third-order error; the three
+        // kicks only flag wall contact, the step counts it once
+        const float w1 = 1.3512071919596578f;
+        const float w0 = -1.7024143839193153f;
+        Drift(world, context, 0.5f * w1 * dt);
+        Forces(world, context);
+        KickDrift(world, context, w1 * dt, 0.5f * (w1 + w0) * dt);
+        Forces(world, context);
+        KickDrift(world, context, w0 * dt, 0.5f * (w0 + w1) * dt);
+        Forces(world, context);
+        KickDrift(world, context, w1 * dt, 0.5f * w1 * dt);
+        break;
+    }
+    default:
+        Forces(world, context);
+        KickDrift(world, context, dt, dt);
+        world->forcesFresh = false;
+        break;
+    }
+}
+
+// Finest level when object i touches a wall or could reach one within the block, otherwise the
+// coarsest level whose step keeps half the acceleration times the step squared below blockAccuracy
+// of the smaller half axis. The acceleration is the last force evaluation's.
+static int BlockLevel(const World* world, int i, float dt, Vector2 extAcceleration)
+{
+    float ax = world->forceX[i] / world->mass[i] + extAcceleration.x;
+    float ay = world->forceY[i] / world->mass[i] + extAcceleration.y;
+    float acceleration = sqrtf(ax * ax + ay * ay);
+    float speed = sqrtf(world->speedX[i] * world->speedX[i] + world->speedY[i] * world->speedY[i]);
+    float travel = speed * dt + 0.5f * acceleration * dt * dt;
+    float x = world->posX[i], y = world->posY[i];
+    float sizeX = world->sizeX[i], sizeY = world->sizeY[i];
+    if (x - sizeX < travel || x + sizeX > world->width - travel || y - sizeY < travel || y + sizeY > world->height - travel) {
+        return world->blockLevels;
+    }
+    float limit = world->blockAccuracy * fminf(sizeX, sizeY);
+    int level = 0;
+    for (float step = dt; level < world->blockLevels && 0.5f * acceleration * step * step > limit; step *= 0.5f) {
+        level += 1;
+    }
+    return level;
+}
+
+// Chooses every awake object's level and sorts the awake range finest level first.
+static void SortLevels(World* world, float dt, Vector2 extAcceleration)
+{
+    int finest = world->blockLevels;
+    int* end = world->blockEnd;
+    for (int level = 0; level <= finest + 1; level++) {
+        end[level] = 0;
+    }
+    for (int i = 0; i < world->awakeCount; i++) {
+        int slot = world->objectSlot[i];
+        int level = BlockLevel(world, i, dt, extAcceleration);
+        // one level coarser per step at most, so one small force sample cannot coarsen it all the way
+        int previous = world->blockLevel[slot] < finest ? world->blockLevel[slot] : finest;
+        level = level > previous - 1 ? level : previous - 1;
+        world->blockLevel[slot] = level;
+        end[level] += 1;
+    }
+    for (int level = finest - 1; level >= 0; level--) {
+        end[level] += end[level + 1];
+    }
+    int next[BLOCK_LEVELS_MAX + 1];
+    bool sorted = true;
+    for (int level = 0; level <= finest; level++) {
+        next[level] = end[level + 1];
+    }
+    for (int i = 0; i < world->awakeCount; i++) {
+        int k = next[world->blockLevel[world->objectSlot[i]]]++;
+        world->blockOrder[k] = i;
+        sorted = sorted && k == i;
+    }
+    if (!sorted) {
+        ReorderObjects(world, world->blockOrder);
+    }
+}
+
+// Moves object i to the finest level mid-step; returns its new id. It was kicked for its whole
+// step when it was last due, so the part of that kick it has not used yet is taken back.
+static int Promote(World* world, int i, int tick, float subTick, Vector2 extAcceleration)
+{
+    int finest = world->blockLevels;
+    int slot = world->objectSlot[i];
+    int level = world->blockLevel[slot];
+    int period = 1 << (finest - level);
+    if (tick % period != 0) {
+        float unused = (period - tick % period) * subTick;
+        world->speedX[i] -= (world->forceX[i] / world->mass[i] + extAcceleration.x) * unused;
+        world->speedY[i] -= (world->forceY[i] / world->mass[i] + extAcceleration.y) * unused;
+    }
+    // through the level boundaries one swap at a time, like the sleepers' wake
+    for (int l = level; l < finest; l++) {
+        int first = world->blockEnd[l + 1];
+        SwapObjects(world, i, first);
+        i = first;
+        world->blockEnd[l + 1] += 1;
+    }
+    world->blockLevel[slot] = finest;
+    return i;
+}
+
+// Promotes every object that touches a wall or has a broadphase pair without being at the finest
+// level; returns whether any moved. Pairs are collected by slot, promoting changes ids.
+static bool PromoteTouching(World* world, int tick, float subTick, Vector2 extAcceleration)
+{
+    int finest = world->blockLevels;
+    int* slots = world->blockOrder;
+    int n = 0;
+    for (int i = world->blockEnd[finest]; i < world->awakeCount; i++) {
+        float x = world->posX[i], y = world->posY[i];
+        float sizeX = world->sizeX[i], sizeY = world->sizeY[i];
+        if (x - sizeX < 0 || x + sizeX > world->width || y - sizeY < 0 || y + sizeY > world->height) {
+            slots[n++] = world->objectSlot[i];
+        }
+    }
+    // an object can turn up in many pairs; past capacity the rest wait for the next round
+    for (int w = 0; w < world->pairListCount && world->collisions; w++) {
+        for (int p = 0; p < world->pairLists[w].count && n <= world->capacity - 2; p++) {
+            int a = world->pairLists[w].pairs[p].a, b = world->pairLists[w].pairs[p].b;
+            if (world->blockLevel[world->objectSlot[a]] < finest) slots[n++] = world->objectSlot[a];
+            if (world->blockLevel[world->objectSlot[b]] < finest) slots[n++] = world->objectSlot[b];
+        }
+    }
+    int promoted = 0;
+    for (int k = 0; k < n; k++) {
+        if (world->blockLevel[slots[k]] >= finest) continue;
+        Promote(world, world->slotObject[slots[k]], tick, subTick, extAcceleration);
+        promoted += 1;
+    }
+    return promoted > 0;
+}
+
+static void BlockStep(World* world, WorldStepContext* context)
+{
+    float dt = context->dt;
+    Vector2 extAcceleration = context->extAcceleration;
+    int finest = world->blockLevels;
+    int ticks = 1 << finest;
+    float subTick = dt / ticks;
+    SortLevels(world, dt, extAcceleration);
+    for (int tick = 0; tick < ticks; tick++) {
+        for (bool changed = true; changed;) {
+            int awake = world->awakeCount;
+            if (world->collisions) {
+                ObjectPairs(world, subTick);
+            }
+            // whatever woke was run into, so it joins at the finest level; it has not been kicked
+            // yet, which promoting at tick 0 takes into account
+            int* woken = world->blockOrder;
+            int wokenCount = world->awakeCount - awake;
+            for (int k = 0; k < wokenCount; k++) {
+                woken[k] = world->objectSlot[awake + k];
+                world->blockLevel[woken[k]] = 0;
+            }
+            world->blockEnd[0] = world->awakeCount;
+            for (int k = 0; k < wokenCount; k++) {
+                Promote(world, world->slotObject[woken[k]], 0, subTick, extAcceleration);
+            }
+            // promoting changed ids, so the pairs are found again
+            changed = PromoteTouching(world, tick, subTick, extAcceleration) && world->collisions;
+        }
+        if (world->ccd) {
+            SweepStart(world);
+        }
+
+        // levels down to lowest are due: all of them at tick 0, the finest alone at odd ticks
+        int lowest = finest;
+        for (int t = tick; lowest > 0 && t % 2 == 0; t /= 2) {
+            lowest -= 1;
+        }
+        context->active = world->blockEnd[lowest];
+        if (context->active > 0) {
+            Forces(world, context);
+            for (int level = finest; level >= lowest; level--) {
+                context->first = world->blockEnd[level + 1];
+                context->kick = dt / (1 << level);
+                context->drift = 0;
+                ThreadPoolParallelFor(world->pool, world->blockEnd[level] - context->first, ContactTask, context);
+            }
+            context->first = 0;
+        }
+        world->objectSteps += context->active;
+        world->uniformObjectSteps += world->awakeCount;
+        Drift(world, context, subTick);
+
+        if (world->ccd) {
+            context->dt = subTick;
+            Sweep(world, context);
+            context->dt = dt;
+        }
+    }
+    world->forcesFresh = false;
+}
+
+// Once per step, when its state is final: the wall contacts of every kick fold into the bounce
+// counters, so they count steps in contact however many substeps or block levels the step took,
+// the next spatial sort comes a step closer, and resting islands fall asleep.
+static void FinishStep(World* world, float dt)
+{
+    for (int i = 0; i < world->awakeCount; i++) {
+        world->bounceX[i] = world->touchX[i] ? world->bounceX[i] + 1 : 0;
+        world->bounceY[i] = world->touchY[i] ? world->bounceY[i] + 1 : 0;
+        world->touchX[i] = 0;
+        world->touchY[i] = 0;
+    }
+    world->reorderCountdown -= 1;
+    if (world->sleeping) {
+        UpdateIslands(world, dt);
+    }
+}
+
+void WorldStep(World* world, float dt, Vector2 extAcceleration, float u)
+{
+    WorldStepContext context = { world, dt, extAcceleration, u, dt, dt };
+    // a long-range solver makes everything one island, so anything awake wakes the rest
+    bool accelerationChanged = extAcceleration.x != world->lastAcceleration.x || extAcceleration.y != world->lastAcceleration.y;
+    if (!world->sleeping || accelerationChanged || (world->solver != GRAVITY_SOLVER_CUTOFF && world->awakeCount > 0)) {
+        WorldWakeAll(world);
+    }
+    world->lastAcceleration = extAcceleration;
+    if (world->awakeCount == 0) return;
+
+    if (world->blockSteps) {
+        BlockStep(world, &context);
+        if (!world->adaptiveTrying) {
+            FinishStep(world, dt);
+        }
+        return;
+    }
+
+    // pairs first: waking changes the awake range that the other passes run over
+    if (world->collisions) {
+        ObjectPairs(world, dt);
+    }
+    if (world->ccd) {
+        SweepStart(world);
+    }
+    context.active = world->awakeCount;
+    Integrate(world, &context);
+    if (world->ccd) {
+        Sweep(world, &context);
+    }
+    if (!world->adaptiveTrying) {
+        FinishStep(world, dt);
+    }
+}
+
+typedef struct {
+    int forceEvaluations;
+    int sweeps;
+    int wakes;
+    long long objectSteps;
+    long long uniformObjectSteps;
+} StepCounters;
+
+static StepCounters ReadCounters(const World* world)
+{
+    return (StepCounters) { world->forceEvaluations, world->sweeps, world->wakes, world->objectSteps, world->uniformObjectSteps };
+}
+
+static void WriteCounters(World* world, StepCounters counters)
+{
+    world->forceEvaluations = counters.forceEvaluations;
+    world->sweeps = counters.sweeps;
+    world->wakes = counters.wakes;
+    world->objectSteps = counters.objectSteps;
+    world->uniformObjectSteps = counters.uniformObjectSteps;
+}
+
+// Saved by slot, since a step may reorder ids or wake islands.
+static void SaveState(World* world)
+{
+    for (int i = 0; i < world->count; i++) {
+        int slot = world->objectSlot[i];
+        world->savedPosX[slot] = world->posX[i];
+        world->savedPosY[slot] = world->posY[i];
+        world->savedSpeedX[slot] = world->speedX[i];
+        world->savedSpeedY[slot] = world->speedY[i];
+        world->savedBounceX[slot] = world->bounceX[i];
+        world->savedBounceY[slot] = world->bounceY[i];
+        world->savedRestTime[slot] = world->restTime[i];
+        world->savedBlockLevel[slot] = world->blockLevel[slot];
+    }
+    world->savedSleeperCount = 0;
+    for (int i = world->awakeCount; i < world->count; i++) {
+        world->savedSleepers[world->savedSleeperCount++] = world->objectSlot[i];
+    }
+    world->savedAcceleration = world->lastAcceleration;
+}
+
+static void RestoreState(World* world)
+{
+    // islands a try woke go back to sleep; their island lists were never touched
+    for (int k = 0; k < world->savedSleeperCount; k++) {
+        int id = world->slotObject[world->savedSleepers[k]];
+        if (id >= world->awakeCount) continue;
+        SwapObjects(world, id, --world->awakeCount);
+        world->forceX[world->awakeCount] = 0;
+        world->forceY[world->awakeCount] = 0;
+        world->sleepGridDirty = true;
+        NeighborListInvalidate(&world->neighborList);
+    }
+    for (int i = 0; i < world->count; i++) {
+        int slot = world->objectSlot[i];
+        bool awake = i < world->awakeCount;
+        world->posX[i] = world->savedPosX[slot];
+        world->posY[i] = world->savedPosY[slot];
+        world->speedX[i] = awake ? world->savedSpeedX[slot] : 0;
+        world->speedY[i] = awake ? world->savedSpeedY[slot] : 0;
+        world->bounceX[i] = world->savedBounceX[slot];
+        world->bounceY[i] = world->savedBounceY[slot];
+        world->touchX[i] = 0;
+        world->touchY[i] = 0;
+        world->restTime[i] = world->savedRestTime[slot];
+        world->blockLevel[slot] = world->savedBlockLevel[slot];
+    }
+    world->lastAcceleration = world->savedAcceleration;
+    world->forcesFresh = false;
+}
+
+static void KeepTrial(World* world)
+{
+    for (int i = 0; i < world->count; i++) {
+        int slot = world->objectSlot[i];
+        world->trialPosX[slot] = world->posX[i];
+        world->trialPosY[slot] = world->posY[i];
+        world->trialSpeedX[slot] = world->speedX[i];
+        world->trialSpeedY[slot] = world->speedY[i];
+    }
+}
+
+// How far an object at x, y is inside the walls, 0 when clear of them.
+static inline float WallDepth(const World* world, int i, float x, float y)
+{
+    float gapX = fminf(x - world->sizeX[i], world->width - x - world->sizeX[i]);
+    float gapY = fminf(y - world->sizeY[i], world->height - y - world->sizeY[i]);
+    return fmaxf(-fminf(gapX, gapY), 0);
+}
+
+// Largest difference between the full step and the two halves, speeds times one second. Neither
+// sees a wall the step ran into after its middle, so an object that starts clear of the walls
+// also counts how deep it ends up inside them: the step shrinks until the contact starts on time.
+static float StepError(const World* world)
+{
+    float largest = 0;
+    for (int i = 0; i < world->count; i++) {
+        int slot = world->objectSlot[i];
+        float dx = world->posX[i] - world->trialPosX[slot];
+        float dy = world->posY[i] - world->trialPosY[slot];
+        float dvx = world->speedX[i] - world->trialSpeedX[slot];
+        float dvy = world->speedY[i] - world->trialSpeedY[slot];
+        largest = fmaxf(largest, fmaxf(dx * dx + dy * dy, dvx * dvx + dvy * dvy));
+        if (WallDepth(world, i, world->savedPosX[slot], world->savedPosY[slot]) == 0) {
+            float entry = WallDepth(world, i, world->posX[i], world->posY[i]);
+            largest = fmaxf(largest, entry * entry);
+        }
+    }
+    return sqrtf(largest);
+}
+
+float WorldStepAdaptive(World* world, float maxDt, Vector2 extAcceleration, float u)
+{
+    SaveState(world);
+    StepCounters counters = ReadCounters(world);
+    world->adaptiveTrying = true;
+    for (;;) {
+        float dt = fminf(fminf(world->adaptiveDt, world->adaptiveMaxDt), maxDt);
+        WorldStep(world, dt, extAcceleration, u);
+        KeepTrial(world);
+        RestoreState(world);
+        WriteCounters(world, counters);
+        WorldStep(world, 0.5f * dt, extAcceleration, u);
+        WorldStep(world, 0.5f * dt, extAcceleration, u);
+        float error = StepError(world);
+        // the local error of a first-order step goes with dt^2
+        float scale = error > 0 ? 0.9f * sqrtf(world->adaptiveTolerance / error) : 5;
+        scale = fminf(fmaxf(scale, 0.2f), 5);
+        float next = fminf(fmaxf(dt * scale, world->adaptiveMinDt), world->adaptiveMaxDt);
+        if (error <= world->adaptiveTolerance || dt <= world->adaptiveMinDt) {
+            world->accepted += 1;
+            // a step cut short by maxDt says little about how long it could have been
+            if (dt == world->adaptiveDt || next < world->adaptiveDt) {
+                world->adaptiveDt = next;
+            }
+            world->adaptiveTrying = false;
+            FinishStep(world, dt);
+            return dt;
+        }
+        world->rejected += 1;
+        world->adaptiveDt = next;
+        RestoreState(world);
+        WriteCounters(world, counters);
+    }
+}
+
+ObjectDrawDescriptor WorldDrawDescriptor(const World* world, int id)
+{
+    ObjectDrawDescriptor dd;
+    dd.pos = (Vector2) { world->posX[id], world->posY[id] };
+    dd.size = (Vector2) { world->drawSizeX[id], world->drawSizeY[id] };
+    return dd;
+}
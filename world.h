@@ -0,0 +1,250 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "raylib.h"
+
+#include "gravity.h"
+#include "barneshut.h"
+#include "fmm.h"
+#include "particlemesh.h"
+#include "neighborlist.h"
+#include "spatialhash.h"
+#include "aabbtree.h"
+#include "threadpool.h"
+
+typedef struct {
+    float mass;
+    Vector2 pos;
+    Vector2 speed;
+    Vector2 size;
+    float stiffness;
+    float energyLoss;
+} ObjectDescriptor;
+
+typedef struct {
+    Vector2 size;
+    Vector2 pos;
+} ObjectDrawDescriptor;
+
+// First contact of two fast objects within a substep, as a fraction of it.
+typedef struct {
+    float time;
+    int a, b;
+} Impact;
+
+// How WorldStep advances positions and speeds between force evaluations. Euler is the original
+// semi-implicit step; the others are symplectic, so orbits stay closed instead of spiralling.
+typedef enum {
+    INTEGRATOR_EULER = 0,
+    INTEGRATOR_LEAPFROG, // drift half, kick, drift half; one force pass
+    INTEGRATOR_VERLET, // kick half, drift, kick half; one force pass, reused by the next step
+    INTEGRATOR_YOSHIDA4, // three leapfrogs of Yoshida's weights, fourth order; three force passes
+    INTEGRATOR_COUNT
+} Integrator;
+
+// Most levels of block timesteps, see World.
+#define BLOCK_LEVELS_MAX 16
+
+// Stable reference to a spawned object. The slot is reused after a despawn, the generation
+// tells the old handle from the new one.
+typedef struct {
+    int slot;
+    unsigned int generation;
+} ObjectHandle;
+
+// Structure-of-arrays simulation state. Live objects are packed in [0, count) and every array
+// is indexed by that dense id; despawning moves the last object into the hole, so ids change
+// but handle slots do not. Sound and render data live in side tables owned by the caller,
+// indexed by slot (objectSlot[id]). All memory is allocated once, for capacity objects.
+typedef struct {
+    int count;
+    int capacity;
+
+    // hot, read and written every substep
+    float* posX;
+    float* posY;
+    float* speedX;
+    float* speedY;
+    float* mass;
+    float* sizeX;
+    float* sizeY;
+    float* stiffness;
+    float* energyLoss;
+    float* forceX; // gravity gathered for the current substep
+    float* forceY;
+
+    // contact outputs: steps in a row spent touching a wall and the squished size to draw
+    int* bounceX;
+    int* bounceY;
+    int* touchX; // a kick of the current step found the wall, folded into bounce at its end
+    int* touchY;
+    float* drawSizeX;
+    float* drawSizeY;
+
+    // handle slots
+    int* objectSlot; // dense id -> slot
+    int* slotObject; // slot -> dense id, or the next free slot while the slot is free
+    unsigned int* slotGeneration;
+    int freeSlot; // head of the free list, -1 when the world is full
+
+    float width;
+    float height;
+
+    bool simd; // vector kernels from simd.h instead of the scalar reference loops
+    // Wall spring and damper taken at the end of the substep (linearly implicit backward Euler):
+    // stable at any dt, where the explicit force needs dt < 2 / sqrt(k / m).
+    bool implicitContact;
+    bool symmetric; // direct solver visits each pair once and applies both halves
+    float* pairAccX; // per-worker force accumulators of the symmetric passes, capacity floats each
+    float* pairAccY;
+    float* squishAccX; // per-worker squish accumulators of object contact
+    float* squishAccY;
+    int pairWorkers;
+    ThreadPool* pool; // splits the gravity and contact loops across threads, NULL runs them inline
+    GravitySolver solver;
+    BarnesHut barnesHut;
+    Fmm fmm;
+    ParticleMesh particleMesh;
+    NeighborList neighborList;
+
+    // object-object collisions: candidate pairs from the broadphase, one list per pool worker,
+    // and how far other objects pressed into each one this substep
+    bool collisions;
+    float* squishX;
+    float* squishY;
+    int reorderInterval; // substeps between spatial sorts of the object arrays, 0 never
+    int reorderCountdown;
+    void* scratch; // capacity floats, swapped in and out by the sort
+    Broadphase broadphase;
+    SpatialHash grid;
+    AabbTree tree; // keyed by handle slot
+    PairList* pairLists;
+    int pairListCount;
+
+    // Sleeping: objects [awakeCount, count) are at rest and skipped by every pass. Islands are
+    // groups linked by touching, or by cutoff gravity; with a long-range solver everything is one
+    // island. An island falls asleep once all of it stayed below sleepSpeed for sleepTime seconds
+    // and wakes as a whole when something runs into it or a member is despawned.
+    bool sleeping;
+    int awakeCount; // equals count while sleeping is off
+    float sleepSpeed;
+    float sleepTime;
+    float* restTime; // seconds spent below sleepSpeed
+    int* islandNext; // per slot: next slot of the same sleeping island, -1 at the end
+    int* islandHead; // per slot: first slot of its sleeping island
+    int* islandParent; // union-find over awake ids, scratch of the island pass
+    int* islandFirst; // per island root, scratch of the island pass
+    float* islandRest; // per island root: the shortest rest time of its members
+    SpatialHash sleepGrid; // sleepers, rebuilt when the sleeping set changes
+    bool sleepGridDirty;
+    PairList* contactLists; // pairs that touched this substep, one list per pool worker
+    Vector2 lastAcceleration; // a change wakes everything
+    int islandCount; // awake islands in the last island pass
+    int wakes; // islands woken since init
+
+    // Continuous collision: an object moving more than ccdThreshold of its smaller half axis in a
+    // substep, or before its spring could stop it, is swept against the walls and, through swept
+    // broadphase queries, against the other objects. It stops at the first contact and bounces
+    // with the restitution of its own spring and damper instead of landing deep inside, so fast
+    // objects no longer need small substeps.
+    bool ccd;
+    float ccdThreshold;
+    PairList sweepPairs; // candidates of the fast objects
+    Impact* impacts;
+    int impactCapacity;
+    int* sweepMark; // per id: the sweep pass that already moved the object
+    int sweepEpoch;
+    int sweeps; // pair impacts since init
+
+    // Adaptive stepping (WorldStepAdaptive) by step doubling: every step is also taken as two
+    // halves from the same start, and for a first-order method the difference between the two
+    // results estimates the error of the halves. The halves see every force mid-step, a contact
+    // starting before the middle of the step included; later wall contacts count their entry
+    // depth. A speed difference counts as the distance it makes up over one second, since a
+    // bounce that comes out too fast is off for the whole flight after it. The largest error is
+    // kept below adaptiveTolerance px by rejecting and shrinking steps, and dt grows again in
+    // free flight.
+    float adaptiveTolerance;
+    float adaptiveDt; // next step to try
+    float adaptiveMinDt; // always accepted
+    float adaptiveMaxDt;
+    float* savedPosX; // per slot: state before the step, restored when it is rejected
+    float* savedPosY;
+    float* savedSpeedX;
+    float* savedSpeedY;
+    int* savedBounceX;
+    int* savedBounceY;
+    float* savedRestTime;
+    int* savedBlockLevel;
+    int* savedSleepers; // slots asleep before the step, put back to sleep if a try woke them
+    int savedSleeperCount;
+    Vector2 savedAcceleration;
+    // Set while the tries run: their steps leave the bounce counters, the reorder countdown and
+    // falling asleep to the accepted step, and forceEvaluations, sweeps, wakes and objectSteps
+    // only count the halves that were kept.
+    bool adaptiveTrying;
+    float* trialPosX; // per slot: where the single full step ended
+    float* trialPosY;
+    float* trialSpeedX;
+    float* trialSpeedY;
+    int accepted; // adaptive steps since init
+    int rejected;
+
+    // Every integrator evaluates the same forces: gravity, object contact when collisions are on,
+    // and the wall contact at the position the object has when it is kicked. A kick changes
+    // speeds, a drift moves objects with their speed; how the two are interleaved is the scheme.
+    Integrator integrator;
+    bool forcesFresh; // forceX/forceY still belong to the current positions, for velocity Verlet
+    int forceEvaluations; // force passes since init
+    float* sweepStartX; // per id: position at the start of the step, where CCD sweeps from
+    float* sweepStartY;
+
+    // Block timesteps: WorldStep splits dt into 2^blockLevels sub-ticks and every object steps
+    // with dt / 2^level, the coarsest step that keeps half its acceleration times the step squared
+    // below blockAccuracy of its smaller half axis. An object touching, or within a block's travel
+    // of, a wall or another object takes the finest level. Levels are chosen once per WorldStep and
+    // grow coarser by one at most; an object that runs into something mid-step moves to the finest
+    // level at once and gives back the part of its last kick it has not used. The awake objects are
+    // sorted finest level first, so the objects due at a sub-tick are a prefix of the awake range:
+    // only they get forces and a semi-implicit Euler kick, while every object drifts every sub-tick,
+    // which is where the others are predicted to be when the due ones evaluate their forces.
+    bool blockSteps;
+    int blockLevels; // at most BLOCK_LEVELS_MAX
+    float blockAccuracy;
+    int* blockLevel; // per slot
+    int* blockOrder; // scratch of the level sort
+    int blockEnd[BLOCK_LEVELS_MAX + 2]; // objects with level >= L are [0, blockEnd[L])
+    long long objectSteps; // kicks of single objects since init
+    long long uniformObjectSteps; // kicks that stepping every awake object every sub-tick would take
+} World;
+
+ObjectDescriptor MakeObjectDescriptor(float mass, Vector2 pos, Vector2 speed, Vector2 size, float stiffness, float energyLoss);
+
+void WorldInit(World* world, int capacity, float width, float height);
+void WorldFree(World* world);
+// Takes a slot from the free list; the handle has slot -1 when the world is full.
+ObjectHandle WorldSpawn(World* world, ObjectDescriptor descriptor);
+// Returns false for stale handles.
+bool WorldDespawn(World* world, ObjectHandle handle);
+// Dense id of a live object, -1 for stale handles.
+int WorldResolve(const World* world, ObjectHandle handle);
+// Wakes the island of a sleeping object; ids change.
+void WorldWake(World* world, ObjectHandle handle);
+void WorldWakeAll(World* world);
+// Scalar reference for wall contact and integration of objects [begin, end), using forceX/forceY:
+// speeds are kicked for kick seconds, then positions drift for drift seconds with the new speed.
+void WorldContactIntegrate(World* world, int begin, int end, float kick, float drift, Vector2 extAcceleration, float u);
+// Rebuilds the broadphase over the awake objects and gathers candidate pairs into pairLists.
+// With the grid, every reorderInterval calls it also sorts the objects into grid order, which
+// changes ids.
+void WorldFindPairs(World* world);
+// Gravity for every awake object, object-object contact when collisions are on, then wall contact
+// and integration for every awake object, interleaved as the integrator says, and with sleeping on
+// the island pass.
+void WorldStep(World* world, float dt, Vector2 extAcceleration, float u);
+// One accepted step of at most maxDt, with dt chosen by the error controller; returns the dt
+// taken. Rejected tries are rolled back and retried with a smaller dt.
+float WorldStepAdaptive(World* world, float maxDt, Vector2 extAcceleration, float u);
+ObjectDrawDescriptor WorldDrawDescriptor(const World* world, int id);
+
+#endif